@@ -0,0 +1,206 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _ALARM_CONFIG_H_
+#define _ALARM_CONFIG_H_
+
+//=====[Declaration of public defines]=========================================
+
+// Build options shared by all modules. Each one can be overridden on the
+// compiler command line or in the "macros" list of mbed_app.json.
+
+// Input handling mode (e.g. -DALARM_EVENT_DRIVEN=0):
+//   1 = D2/D3 are InterruptIn sources that post to eventQueue, MCU sleeps between events
+//   0 = original 100 ms polling superloop, kept as a fallback for latency A/B tests
+#ifndef ALARM_EVENT_DRIVEN
+#define ALARM_EVENT_DRIVEN      1
+#endif
+
+// Low power idle for battery backed units (-DALARM_LOW_POWER=1): the UART RX
+// interrupt is released once the link is quiet, so the MCU can enter deep sleep
+// with only D2/D3 and the RX pin wake-up armed
+#ifndef ALARM_LOW_POWER
+#define ALARM_LOW_POWER         0
+#endif
+#if ALARM_LOW_POWER && !ALARM_EVENT_DRIVEN
+#error "ALARM_LOW_POWER needs ALARM_EVENT_DRIVEN"
+#endif
+
+// Prioritised threads (-DALARM_THREADED=1): the event driven handlers are split
+// over an alarm/input thread, a command thread and a report thread, each with
+// its own EventQueue, see threads.cpp for the priorities and stack sizes.
+#ifndef ALARM_THREADED
+#define ALARM_THREADED          0
+#endif
+#if ALARM_THREADED && !ALARM_EVENT_DRIVEN
+#error "ALARM_THREADED needs ALARM_EVENT_DRIVEN"
+#endif
+
+// Latency instrumentation (-DALARM_PROFILE=1): DWT cycle counter timings of
+// the alarm stages and of sensor edge to LED, read with the stats command.
+// When 0 the profile calls are empty inline functions and compile out.
+#ifndef ALARM_PROFILE
+#define ALARM_PROFILE           0
+#endif
+
+// Watchdog supervisor (-DALARM_SUPERVISOR=0 to leave it out): the watchdog is
+// only kicked while the alarm loop and every thread have checked in within
+// SUPERVISOR_PERIOD_MS, so a stall resets the board after
+// SUPERVISOR_WATCHDOG_MS. Misses and the reset cause are kept in backup SRAM.
+// The IWDG keeps counting in stop mode, so every supervisor period wakes the
+// MCU. With ALARM_LOW_POWER the period is 10 s instead of 500 ms, one wake-up
+// more than the status report every 10 s rather than 2 a second, at the cost
+// of a stall taking up to 25 s instead of 4 s to reset the board.
+#ifndef ALARM_SUPERVISOR
+#define ALARM_SUPERVISOR        1
+#endif
+#ifndef SUPERVISOR_PERIOD_MS
+#if ALARM_LOW_POWER
+#define SUPERVISOR_PERIOD_MS    10000
+#else
+#define SUPERVISOR_PERIOD_MS    500
+#endif
+#endif
+#ifndef SUPERVISOR_WATCHDOG_MS
+#if ALARM_LOW_POWER
+#define SUPERVISOR_WATCHDOG_MS  25000
+#else
+#define SUPERVISOR_WATCHDOG_MS  4000
+#endif
+#endif
+#if SUPERVISOR_WATCHDOG_MS > 32000
+#error "The IWDG times out after 32 s at the most"
+#endif
+
+// Analog gas and temperature channels (-DALARM_ANALOG=1): the analog entries of
+// the sensor table are scanned by ADC1 over DMA and compared with their
+// thresholds, in mV, with hysteresis. ANALOG_WATCHDOG=1 also arms the ADC analog
+// watchdog on the first analog channel, so it trips within one conversion.
+#ifndef ALARM_ANALOG
+#define ALARM_ANALOG            0
+#endif
+#ifndef ANALOG_WATCHDOG
+#define ANALOG_WATCHDOG         0
+#endif
+#if ANALOG_WATCHDOG && !ALARM_ANALOG
+#error "ANALOG_WATCHDOG needs ALARM_ANALOG"
+#endif
+#ifndef ANALOG_GAS_THRESHOLD_MV
+#define ANALOG_GAS_THRESHOLD_MV         1500
+#endif
+#ifndef ANALOG_GAS_HYSTERESIS_MV
+#define ANALOG_GAS_HYSTERESIS_MV        100
+#endif
+#ifndef ANALOG_TEMP_THRESHOLD_MV
+#define ANALOG_TEMP_THRESHOLD_MV        2000
+#endif
+#ifndef ANALOG_TEMP_HYSTERESIS_MV
+#define ANALOG_TEMP_HYSTERESIS_MV       100
+#endif
+
+// Raw sample streaming (-DANALOG_STREAM=1): the stream command sends every ADC
+// block as a delta coded samples packet, averaged over ANALOG_STREAM_DECIMATION
+// scans by default. Frames go out by TX DMA between the other messages.
+#ifndef ANALOG_STREAM
+#define ANALOG_STREAM           0
+#endif
+#if ANALOG_STREAM && !ALARM_ANALOG
+#error "ANALOG_STREAM needs ALARM_ANALOG"
+#endif
+#ifndef ANALOG_STREAM_DECIMATION
+#define ANALOG_STREAM_DECIMATION        4
+#endif
+
+// Multi-drop RS-485 bus (-DALARM_MODBUS=1): the UART answers Modbus RTU
+// requests addressed to MODBUS_ADDRESS, and to broadcast writes, instead of
+// running the text command line. Frames are received by circular DMA and ended
+// by the UART idle line interrupt, replies go out by DMA with MODBUS_DE_PIN
+// driving the transceiver only while they do. Nothing is sent unasked, so the
+// text reports, warnings and messages are not sent at all in this build.
+#ifndef ALARM_MODBUS
+#define ALARM_MODBUS            0
+#endif
+#ifndef MODBUS_ADDRESS
+#define MODBUS_ADDRESS          1       // 1 to 247, unique on the bus
+#endif
+#ifndef MODBUS_DE_PIN
+#define MODBUS_DE_PIN           D8      // RS-485 transceiver driver enable, active high
+#endif
+// Key the unlock register takes, a secret of each device set with the
+// "modbus-unlock-key" config value of mbed_app.json or on the command line.
+// There is no default, so no two boards share a key by accident.
+#if !defined(MODBUS_UNLOCK_KEY) && defined(MBED_CONF_APP_MODBUS_UNLOCK_KEY)
+#define MODBUS_UNLOCK_KEY       MBED_CONF_APP_MODBUS_UNLOCK_KEY
+#endif
+#if ALARM_MODBUS && !defined(MODBUS_UNLOCK_KEY)
+#error "ALARM_MODBUS needs MODBUS_UNLOCK_KEY, set modbus-unlock-key in mbed_app.json"
+#endif
+#if ALARM_MODBUS && (MODBUS_ADDRESS < 1 || MODBUS_ADDRESS > 247)
+#error "MODBUS_ADDRESS must be 1 to 247"
+#endif
+#if ALARM_MODBUS && ANALOG_STREAM
+#error "ALARM_MODBUS and ANALOG_STREAM both need the UART TX DMA"
+#endif
+#if ALARM_MODBUS && ALARM_LOW_POWER
+#error "ALARM_MODBUS keeps the RX DMA running, it cannot use ALARM_LOW_POWER"
+#endif
+
+// Ethernet publisher (-DALARM_NETWORK=1): every status report, and every status
+// change, is also sent as a UDP datagram to NETWORK_HOST:NETWORK_PORT from a
+// low priority network thread, which reconnects with a backoff of
+// NETWORK_RETRY_MIN_MS doubling up to NETWORK_RETRY_MAX_MS
+#ifndef ALARM_NETWORK
+#define ALARM_NETWORK           0
+#endif
+#ifndef NETWORK_HOST
+#define NETWORK_HOST            "192.168.1.10"
+#endif
+#ifndef NETWORK_PORT
+#define NETWORK_PORT            5140
+#endif
+#ifndef NETWORK_RETRY_MIN_MS
+#define NETWORK_RETRY_MIN_MS    1000
+#endif
+#ifndef NETWORK_RETRY_MAX_MS
+#define NETWORK_RETRY_MAX_MS    60000
+#endif
+#if ALARM_NETWORK && ALARM_LOW_POWER
+#error "ALARM_NETWORK keeps the Ethernet MAC running, it cannot use ALARM_LOW_POWER"
+#endif
+
+// Footprint builds: mbed_app_size.json selects minimal-printf, the small C
+// library, no stats and fewer drivers, and mbed_app_bare_metal.json does the
+// same without the RTOS. Build either with --profile profiles/size.json, which
+// adds LTO, then check the image with tools/size_budget.py. Without the RTOS
+// there is a single thread, so the threaded and network builds need it.
+#if (ALARM_THREADED || ALARM_NETWORK) && !MBED_CONF_RTOS_PRESENT
+#error "ALARM_THREADED and ALARM_NETWORK need the RTOS, not mbed_app_bare_metal.json"
+#endif
+
+// Lockout backoff: the first lockout after MAX_INCORRECT_CODES incorrect codes
+// lasts ALARM_LOCKOUT_BASE_MS, each further incorrect code after it doubles the
+// time, up to ALARM_LOCKOUT_MAX_DOUBLINGS times. The unlock command ends it.
+#ifndef ALARM_LOCKOUT_BASE_MS
+#define ALARM_LOCKOUT_BASE_MS           30000
+#endif
+#ifndef ALARM_LOCKOUT_MAX_DOUBLINGS
+#define ALARM_LOCKOUT_MAX_DOUBLINGS     7
+#endif
+
+// Secret the unlock and code commands must give, as a string, set with the
+// "admin-secret" config value of mbed_app.json or on the command line. It is
+// compared in constant time. Without one both commands are always refused.
+#if !defined(ALARM_ADMIN_SECRET) && defined(MBED_CONF_APP_ADMIN_SECRET)
+#define ALARM_ADMIN_SECRET      MBED_CONF_APP_ADMIN_SECRET
+#endif
+
+// Time an input must hold a new level before the debounced state follows it
+#ifndef SENSOR_DEBOUNCE_MS
+#define SENSOR_DEBOUNCE_MS      20
+#endif
+#ifndef BUTTON_DEBOUNCE_MS
+#define BUTTON_DEBOUNCE_MS      50
+#endif
+
+//=====[#include guards - end]=================================================
+
+#endif // _ALARM_CONFIG_H_
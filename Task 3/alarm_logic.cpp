@@ -0,0 +1,284 @@
+//=====[Libraries]=============================================================
+
+#include "alarm_logic.h"
+
+//=====[Declaration of private defines]========================================
+
+static_assert(ALARM_LOCKOUT_MAX_DOUBLINGS < 16, "Longest lockout backoff overflows");
+
+//=====[Declaration of private data types]=====================================
+
+typedef struct {
+    alarmLogicState_t from;
+    alarmLogicTrigger_t trigger;
+    alarmLogicState_t to;
+    alarmLogicEvents_t events;      // Also drive the counter: reset on DEACTIVATED and UNLOCKED, +1 on CODE_INCORRECT
+} alarmRule_t;
+
+typedef struct {
+    alarmLogicState_t to;
+    alarmLogicEvents_t events;
+} alarmTransition_t;
+
+typedef struct {
+    alarmTransition_t transitions[ALARM_STATES][ALARM_TRIGGERS];
+} alarmTable_t;
+
+// What each state shows, so the LEDs and flags can never disagree with it
+typedef struct {
+    const char* name;
+    bool alarmState;
+    bool incorrectCode;
+    bool systemBlocked;
+    bool codeEntryNeeded;           // The code buttons must be polled
+} alarmOutputs_t;
+
+//=====[Declaration and initialization of private constants]===================
+
+// Every transition. A trigger with no rule for the current state leaves it
+// unchanged, so the lockout ignores the buttons until its backoff ends and the
+// idle state ignores them always.
+static constexpr alarmRule_t alarmRules[] = {
+    { ALARM_STATE_IDLE,       ALARM_TRIGGER_SENSOR,           ALARM_STATE_ALARM,      ALARM_LOGIC_ACTIVATED },
+    { ALARM_STATE_ALARM,      ALARM_TRIGGER_CODE_KEY,         ALARM_STATE_CODE_ENTRY, 0 },
+    { ALARM_STATE_ALARM,      ALARM_TRIGGER_ACKNOWLEDGE,      ALARM_STATE_CODE_ENTRY, 0 },
+    { ALARM_STATE_ALARM,      ALARM_TRIGGER_ENTER_CORRECT,    ALARM_STATE_IDLE,       ALARM_LOGIC_DEACTIVATED },
+    { ALARM_STATE_ALARM,      ALARM_TRIGGER_ENTER_WRONG,      ALARM_STATE_WRONG_CODE, ALARM_LOGIC_CODE_INCORRECT },
+    { ALARM_STATE_ALARM,      ALARM_TRIGGER_ENTER_LAST_WRONG, ALARM_STATE_LOCKOUT,
+      ALARM_LOGIC_CODE_INCORRECT | ALARM_LOGIC_LOCKOUT },
+    { ALARM_STATE_CODE_ENTRY, ALARM_TRIGGER_KEYS_RELEASED,    ALARM_STATE_ALARM,      0 },
+    { ALARM_STATE_CODE_ENTRY, ALARM_TRIGGER_ENTER_CORRECT,    ALARM_STATE_IDLE,       ALARM_LOGIC_DEACTIVATED },
+    { ALARM_STATE_CODE_ENTRY, ALARM_TRIGGER_ENTER_WRONG,      ALARM_STATE_WRONG_CODE, ALARM_LOGIC_CODE_INCORRECT },
+    { ALARM_STATE_CODE_ENTRY, ALARM_TRIGGER_ENTER_LAST_WRONG, ALARM_STATE_LOCKOUT,
+      ALARM_LOGIC_CODE_INCORRECT | ALARM_LOGIC_LOCKOUT },
+    { ALARM_STATE_WRONG_CODE, ALARM_TRIGGER_ACKNOWLEDGE,      ALARM_STATE_CODE_ENTRY, 0 },
+    { ALARM_STATE_LOCKOUT,    ALARM_TRIGGER_LOCKOUT_EXPIRED,  ALARM_STATE_WRONG_CODE, 0 },
+    { ALARM_STATE_ALARM,      ALARM_TRIGGER_UNLOCK,           ALARM_STATE_ALARM,      ALARM_LOGIC_UNLOCKED },
+    { ALARM_STATE_CODE_ENTRY, ALARM_TRIGGER_UNLOCK,           ALARM_STATE_CODE_ENTRY, ALARM_LOGIC_UNLOCKED },
+    { ALARM_STATE_WRONG_CODE, ALARM_TRIGGER_UNLOCK,           ALARM_STATE_ALARM,      ALARM_LOGIC_UNLOCKED },
+    { ALARM_STATE_LOCKOUT,    ALARM_TRIGGER_UNLOCK,           ALARM_STATE_ALARM,      ALARM_LOGIC_UNLOCKED },
+};
+
+#define ALARM_RULES             ((int)(sizeof(alarmRules) / sizeof(alarmRules[0])))
+
+static constexpr alarmOutputs_t alarmOutputs[ALARM_STATES] = {
+    { "idle",       false, false, false, false },
+    { "alarm",      true,  false, false, true  },
+    { "code entry", true,  false, false, true  },
+    { "wrong code", true,  true,  false, true  },
+    { "lockout",    true,  true,  true,  false },
+};
+
+// Expands the rules into a dense [state][trigger] table, so an update is two
+// lookups however many rules there are
+static constexpr alarmTable_t alarmTableBuild()
+{
+    alarmTable_t table = {};
+
+    for (int state = 0; state < ALARM_STATES; state++) {
+        for (int trigger = 0; trigger < ALARM_TRIGGERS; trigger++) {
+            table.transitions[state][trigger] = { (alarmLogicState_t)state, 0 };
+        }
+    }
+    for (const alarmRule_t& rule : alarmRules) {
+        table.transitions[rule.from][rule.trigger] = { rule.to, rule.events };
+    }
+    return table;
+}
+
+static constexpr bool alarmRulesUnique()
+{
+    for (int i = 0; i < ALARM_RULES; i++) {
+        for (int j = i + 1; j < ALARM_RULES; j++) {
+            if (alarmRules[i].from == alarmRules[j].from && alarmRules[i].trigger == alarmRules[j].trigger) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static constexpr alarmTable_t alarmTable = alarmTableBuild();
+
+static_assert(alarmRulesUnique(), "Two alarm rules share a state and trigger");
+
+//=====[Declarations (prototypes) of private functions]========================
+
+static int buttonTriggerRead(const alarmLogic_t* alarm, inputMask_t inputs, inputMask_t changed);
+static bool codeMatches(inputMask_t entered, inputMask_t code);
+static alarmLogicEvents_t alarmTransition(alarmLogic_t* alarm, alarmLogicTrigger_t trigger);
+static void alarmOutputsApply(alarmLogic_t* alarm);
+
+//=====[Implementations of public functions]===================================
+
+// Starts from a restored state, the system stays blocked across a reset.
+// code is the stored deactivation code, ALARM_CODE_DEFAULT if it is not valid.
+void alarmLogicInit(alarmLogic_t* alarm, bool alarmState, int numberOfIncorrectCodes, inputMask_t code)
+{
+    if (numberOfIncorrectCodes >= MAX_INCORRECT_CODES) {
+        alarm->state = ALARM_STATE_LOCKOUT;
+    } else if (alarmState) {
+        alarm->state = ALARM_STATE_ALARM;
+    } else {
+        alarm->state = ALARM_STATE_IDLE;
+    }
+    alarm->numberOfIncorrectCodes = numberOfIncorrectCodes;
+    alarm->transitionHook = nullptr;
+    if (!alarmLogicCodeWrite(alarm, code)) {
+        alarm->code = ALARM_CODE_DEFAULT;
+    }
+    alarmOutputsApply(alarm);
+}
+
+void alarmLogicHookAttach(alarmLogic_t* alarm, alarmLogicHook_t hook)
+{
+    alarm->transitionHook = hook;
+}
+
+// Runs on an input event: changed are the debounced bits that just changed.
+// The button event, if any, goes first, then an active sensor, so a correct
+// code with a sensor still active sets the alarm again straight away.
+alarmLogicEvents_t alarmLogicInputUpdate(alarmLogic_t* alarm, inputMask_t inputs, inputMask_t changed)
+{
+    alarmLogicEvents_t events = 0;
+
+    if (changed == 0) {
+        return 0;
+    }
+    int buttonTrigger = buttonTriggerRead(alarm, inputs, changed);
+    if (buttonTrigger >= 0) {
+        events |= alarmTransition(alarm, (alarmLogicTrigger_t)buttonTrigger);
+    }
+    if (inputs & INPUT_SENSORS) {                   // Check if gas or temperature sensor is triggered (debounced)
+        events |= alarmTransition(alarm, ALARM_TRIGGER_SENSOR);
+    }
+    return events;
+}
+
+// Runs when the lockout has lasted alarmLogicLockoutMs(): the incorrect code
+// LED stays on until it is acknowledged, then one more attempt is allowed
+alarmLogicEvents_t alarmLogicLockoutExpire(alarmLogic_t* alarm)
+{
+    return alarmTransition(alarm, ALARM_TRIGGER_LOCKOUT_EXPIRED);
+}
+
+// Clears the incorrect codes and any lockout, the alarm itself stays on
+alarmLogicEvents_t alarmLogicUnlock(alarmLogic_t* alarm)
+{
+    return alarmTransition(alarm, ALARM_TRIGGER_UNLOCK);
+}
+
+// A code needs at least one button and not all four, which acknowledge an
+// incorrect code
+bool alarmLogicCodeValid(inputMask_t code)
+{
+    return code != 0 && (code & ~INPUT_CODE_BUTTONS) == 0 && code != INPUT_CODE_BUTTONS;
+}
+
+// Returns false, leaving the code unchanged, if the new one is not valid
+bool alarmLogicCodeWrite(alarmLogic_t* alarm, inputMask_t code)
+{
+    if (!alarmLogicCodeValid(code)) {
+        return false;
+    }
+    alarm->code = code;
+    return true;
+}
+
+// The code entry buttons only matter while there is an alarm to clear or an
+// incorrect code to acknowledge
+bool alarmLogicCodeEntryNeeded(const alarmLogic_t* alarm)
+{
+    return alarmOutputs[alarm->state].codeEntryNeeded;
+}
+
+bool alarmLogicLockout(const alarmLogic_t* alarm)
+{
+    return alarm->state == ALARM_STATE_LOCKOUT;
+}
+
+// Doubles with every incorrect code after the one that first blocked the system
+uint32_t alarmLogicLockoutMs(const alarmLogic_t* alarm)
+{
+    int doublings = alarm->numberOfIncorrectCodes - MAX_INCORRECT_CODES;
+
+    if (doublings < 0) {
+        doublings = 0;
+    } else if (doublings > ALARM_LOCKOUT_MAX_DOUBLINGS) {
+        doublings = ALARM_LOCKOUT_MAX_DOUBLINGS;
+    }
+    return (uint32_t)ALARM_LOCKOUT_BASE_MS << doublings;
+}
+
+const char* alarmLogicStateName(alarmLogicState_t state)
+{
+    return state < ALARM_STATES ? alarmOutputs[state].name : "?";
+}
+
+//=====[Implementations of private functions]==================================
+
+// inputs is one consistent debounced snapshot of all buttons. Returns the
+// ALARM_TRIGGER_* of the button change, or -1 if no button changed.
+static int buttonTriggerRead(const alarmLogic_t* alarm, inputMask_t inputs, inputMask_t changed)
+{
+    inputMask_t code = inputs & INPUT_CODE_BUTTONS;
+
+    if ((changed & INPUT_ENTER_BUTTON) && (inputs & INPUT_ENTER_BUTTON)) {
+        if (codeMatches(code, alarm->code)) {
+            return ALARM_TRIGGER_ENTER_CORRECT;
+        }
+        return (alarm->numberOfIncorrectCodes + 1 >= MAX_INCORRECT_CODES) ?
+               ALARM_TRIGGER_ENTER_LAST_WRONG : ALARM_TRIGGER_ENTER_WRONG;
+    }
+    if (!(changed & INPUT_CODE_BUTTONS)) {
+        return -1;
+    }
+    if ((inputs & (INPUT_CODE_BUTTONS | INPUT_ENTER_BUTTON)) == INPUT_CODE_BUTTONS) {
+        return ALARM_TRIGGER_ACKNOWLEDGE;
+    }
+    if (changed & code) {
+        return ALARM_TRIGGER_CODE_KEY;
+    }
+    return code == 0 ? ALARM_TRIGGER_KEYS_RELEASED : -1;
+}
+
+// Every bit is compared whichever of them differ, so the time taken does not
+// tell how close the entered code was
+static bool codeMatches(inputMask_t entered, inputMask_t code)
+{
+    uint32_t difference = (uint32_t)(entered ^ code);
+
+    return ((difference | (0u - difference)) >> 31) == 0;
+}
+
+static alarmLogicEvents_t alarmTransition(alarmLogic_t* alarm, alarmLogicTrigger_t trigger)
+{
+    const alarmTransition_t* transition = &alarmTable.transitions[alarm->state][trigger];
+    alarmLogicState_t from = alarm->state;
+
+    if (transition->to == from && transition->events == 0) {
+        return 0;                                   // No rule for this trigger here
+    }
+    if (transition->events & (ALARM_LOGIC_DEACTIVATED | ALARM_LOGIC_UNLOCKED)) {
+        alarm->numberOfIncorrectCodes = 0;          // Reset counter (not relevant to Task 3)
+    }
+    if ((transition->events & ALARM_LOGIC_CODE_INCORRECT) &&
+        alarm->numberOfIncorrectCodes < ALARM_INCORRECT_CODES_LIMIT) {
+        alarm->numberOfIncorrectCodes++;            // Increment counter (not relevant to Task 3)
+    }
+    alarm->state = transition->to;
+    alarmOutputsApply(alarm);
+    if (alarm->transitionHook != nullptr && alarm->state != from) {
+        alarm->transitionHook(from, alarm->state, trigger);
+    }
+    return transition->events;
+}
+
+static void alarmOutputsApply(alarmLogic_t* alarm)
+{
+    const alarmOutputs_t* outputs = &alarmOutputs[alarm->state];
+
+    alarm->alarmState = outputs->alarmState;
+    alarm->incorrectCode = outputs->incorrectCode;
+    alarm->systemBlocked = outputs->systemBlocked;
+}
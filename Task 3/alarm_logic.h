@@ -0,0 +1,85 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _ALARM_LOGIC_H_
+#define _ALARM_LOGIC_H_
+
+//=====[Libraries]=============================================================
+
+#include <stdint.h>
+
+#include "alarm_config.h"
+#include "inputs.h"
+
+//=====[Declaration of public defines]=========================================
+
+#define MAX_INCORRECT_CODES     5       // Incorrect codes before the system is blocked
+// Counting stops at the longest backoff, so this is the largest count kept
+#define ALARM_INCORRECT_CODES_LIMIT (MAX_INCORRECT_CODES + ALARM_LOCKOUT_MAX_DOUBLINGS)
+#define ALARM_CODE_DEFAULT      (INPUT_A_BUTTON | INPUT_B_BUTTON)  // A and B pressed, C and D released
+
+// What an update did, so the caller can log it
+#define ALARM_LOGIC_ACTIVATED       (1 << 0)
+#define ALARM_LOGIC_DEACTIVATED     (1 << 1)    // The correct code was entered
+#define ALARM_LOGIC_CODE_INCORRECT  (1 << 2)
+#define ALARM_LOGIC_LOCKOUT         (1 << 3)    // This incorrect code blocked the system
+#define ALARM_LOGIC_UNLOCKED        (1 << 4)    // The unlock command cleared the incorrect codes
+
+//=====[Declaration of public data types]======================================
+
+typedef enum {
+    ALARM_STATE_IDLE,           // No alarm
+    ALARM_STATE_ALARM,          // Alarm on, waiting for the code
+    ALARM_STATE_CODE_ENTRY,     // Alarm on, code buttons being pressed
+    ALARM_STATE_WRONG_CODE,     // Alarm on, incorrect code to acknowledge with all four buttons
+    ALARM_STATE_LOCKOUT,        // Alarm on, MAX_INCORRECT_CODES entered, no attempts until the backoff ends
+    ALARM_STATES
+} alarmLogicState_t;
+
+// Input events, classified from one debounced snapshot and the bits that changed
+typedef enum {
+    ALARM_TRIGGER_SENSOR,           // A sensor is active
+    ALARM_TRIGGER_CODE_KEY,         // A code button was pressed
+    ALARM_TRIGGER_KEYS_RELEASED,    // The last code button was released
+    ALARM_TRIGGER_ACKNOWLEDGE,      // All four code buttons held, Enter released
+    ALARM_TRIGGER_ENTER_CORRECT,    // Enter pressed with the code held
+    ALARM_TRIGGER_ENTER_WRONG,      // Enter pressed with another code
+    ALARM_TRIGGER_ENTER_LAST_WRONG, // Enter pressed with another code, for the last allowed time
+    ALARM_TRIGGER_LOCKOUT_EXPIRED,  // The lockout backoff time is over
+    ALARM_TRIGGER_UNLOCK,           // Unlock command
+    ALARM_TRIGGERS
+} alarmLogicTrigger_t;
+
+typedef void (*alarmLogicHook_t)(alarmLogicState_t from, alarmLogicState_t to,
+                                 alarmLogicTrigger_t trigger);
+
+// Alarm and code entry state. The rules only see a debounced input snapshot
+// and this struct, no mbed objects, so the caller owns the pins and LEDs.
+typedef struct {
+    alarmLogicState_t state;
+    bool alarmState;                // Tracks alarm state (relevant for periodic and continuous reporting)
+    bool incorrectCode;             // Incorrect code LED (not relevant to Task 3)
+    bool systemBlocked;             // Lockout LED (not relevant to Task 3)
+    int numberOfIncorrectCodes;     // Tracks incorrect code attempts (not relevant to Task 3)
+    inputMask_t code;               // INPUT_*_BUTTON bits of the deactivation code
+    alarmLogicHook_t transitionHook;    // Called on every change of state, nullptr if none
+} alarmLogic_t;
+
+typedef uint8_t alarmLogicEvents_t;     // ALARM_LOGIC_* bits
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+void alarmLogicInit(alarmLogic_t* alarm, bool alarmState, int numberOfIncorrectCodes, inputMask_t code);
+void alarmLogicHookAttach(alarmLogic_t* alarm, alarmLogicHook_t hook);
+alarmLogicEvents_t alarmLogicInputUpdate(alarmLogic_t* alarm, inputMask_t inputs, inputMask_t changed);
+alarmLogicEvents_t alarmLogicLockoutExpire(alarmLogic_t* alarm);
+alarmLogicEvents_t alarmLogicUnlock(alarmLogic_t* alarm);
+bool alarmLogicCodeValid(inputMask_t code);
+bool alarmLogicCodeWrite(alarmLogic_t* alarm, inputMask_t code);
+bool alarmLogicCodeEntryNeeded(const alarmLogic_t* alarm);
+bool alarmLogicLockout(const alarmLogic_t* alarm);
+uint32_t alarmLogicLockoutMs(const alarmLogic_t* alarm);
+const char* alarmLogicStateName(alarmLogicState_t state);
+
+//=====[#include guards - end]=================================================
+
+#endif // _ALARM_LOGIC_H_
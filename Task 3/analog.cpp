@@ -0,0 +1,264 @@
+//=====[Libraries]=============================================================
+
+#include "mbed.h"
+#include "arm_book_lib.h"
+
+#include "alarm_config.h"
+#include "analog.h"
+
+#if ALARM_ANALOG
+
+#include "sensors.h"
+
+//=====[Declaration of private defines]========================================
+
+// TIM2 triggers one ADC1 scan of every analog channel ANALOG_SCAN_HZ times a
+// second. DMA2 stream 0 (channel 0, ADC1) writes the scans into a circular
+// buffer of two blocks: while it fills one, the half or full transfer
+// interrupt averages the other, so the CPU sees one interrupt per block.
+#define ANALOG_VREF_MV          3300
+#define ANALOG_FULL_SCALE       4095    // 12 bit conversions
+#define ANALOG_SAMPLE_TIME      7       // 480 ADC clocks, for high impedance sensor outputs
+#define ANALOG_TIM2_TRGO        6       // EXTSEL value of the TIM2 TRGO trigger
+#define ANALOG_CHANNELS         SENSOR_ANALOG_COUNT
+#define ANALOG_BLOCK_LENGTH     (ANALOG_BLOCK_SCANS * ANALOG_CHANNELS)
+
+//=====[Declaration of private data types]=====================================
+
+typedef struct {
+    int sensors[INPUT_SENSOR_LIMIT];    // Index in sensors[] of each scan rank
+} analogRanks_t;
+
+//=====[Declaration and initialization of private constants]===================
+
+static constexpr analogRanks_t analogRanksBuild()
+{
+    analogRanks_t ranks = {};
+    int rank = 0;
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        if (sensors[i].analog) {
+            ranks.sensors[rank++] = i;
+        }
+    }
+    return ranks;
+}
+
+static constexpr analogRanks_t analogRanks = analogRanksBuild();
+
+static constexpr bool analogHysteresisValid()
+{
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        if (sensors[i].analog && sensors[i].hysteresisMv > sensors[i].thresholdMv) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(ANALOG_CHANNELS > 0, "ALARM_ANALOG needs an analog entry in sensors[]");
+static_assert(analogHysteresisValid(), "An analog hysteresis is larger than its threshold");
+
+//=====[Declaration and initialization of private global variables]============
+
+static uint16_t analogBuffer[2 * ANALOG_BLOCK_LENGTH];
+static volatile uint16_t analogLevels[ANALOG_CHANNELS];    // Block averages, in ADC counts
+static volatile inputMask_t analogActiveSensors = 0;
+static analogNotify_t analogNotify = nullptr;
+static analogBlockHandler_t analogBlockHandler = nullptr;
+
+//=====[Declarations (prototypes) of private functions]========================
+
+static constexpr uint16_t millivoltsToCounts(unsigned int millivolts);
+static void analogBlockProcess(const uint16_t* block);
+static void analogDmaIsr();
+#if ANALOG_WATCHDOG
+static void analogWatchdogIsr();
+#endif
+
+//=====[Implementations of public functions]===================================
+
+// Starts the scans. TIM2 and the ADC stop in deep sleep, so deep sleep is
+// locked for as long as the analog channels are watched.
+void analogInit()
+{
+    RCC->APB2ENR |= RCC_APB2ENR_ADC1EN;
+    RCC->AHB1ENR |= RCC_AHB1ENR_DMA2EN;
+    RCC->APB1ENR |= RCC_APB1ENR_TIM2EN;
+
+    ADC123_COMMON->CCR = ADC_CCR_ADCPRE_0;          // 90 MHz APB2 / 4
+    ADC1->CR1 = ADC_CR1_SCAN;
+    ADC1->SMPR1 = 0;
+    ADC1->SMPR2 = 0;
+    ADC1->SQR1 = (uint32_t)(ANALOG_CHANNELS - 1) << ADC_SQR1_L_Pos;
+    ADC1->SQR2 = 0;
+    ADC1->SQR3 = 0;
+
+    for (int rank = 0; rank < ANALOG_CHANNELS; rank++) {
+        PinName pin = sensors[analogRanks.sensors[rank]].pin;
+        uint32_t channel = STM_PIN_CHANNEL(pinmap_function(pin, PinMap_ADC));
+
+        MBED_ASSERT(pinmap_peripheral(pin, PinMap_ADC) == ADC_1);
+        pinmap_pinout(pin, PinMap_ADC);             // Analog mode, no pull
+        if (channel < 10) {
+            ADC1->SMPR2 |= ANALOG_SAMPLE_TIME << (3 * channel);
+        } else {
+            ADC1->SMPR1 |= ANALOG_SAMPLE_TIME << (3 * (channel - 10));
+        }
+        if (rank < 6) {
+            ADC1->SQR3 |= channel << (5 * rank);
+        } else if (rank < 12) {
+            ADC1->SQR2 |= channel << (5 * (rank - 6));
+        } else {
+            ADC1->SQR1 |= channel << (5 * (rank - 12));
+        }
+#if ANALOG_WATCHDOG
+        if (rank == 0) {
+            // Watches the first analog channel on every conversion, between block checks
+            ADC1->HTR = millivoltsToCounts(sensors[analogRanks.sensors[0]].thresholdMv);
+            ADC1->LTR = 0;
+            ADC1->CR1 |= ADC_CR1_AWDEN | ADC_CR1_AWDSGL | ADC_CR1_AWDIE | (channel & ADC_CR1_AWDCH);
+        }
+#endif
+    }
+
+    DMA2_Stream0->CR = 0;
+    DMA2->LIFCR = DMA_LIFCR_CHTIF0 | DMA_LIFCR_CTCIF0 | DMA_LIFCR_CTEIF0 |
+                  DMA_LIFCR_CDMEIF0 | DMA_LIFCR_CFEIF0;
+    DMA2_Stream0->PAR = (uint32_t)&ADC1->DR;
+    DMA2_Stream0->M0AR = (uint32_t)analogBuffer;
+    DMA2_Stream0->NDTR = 2 * ANALOG_BLOCK_LENGTH;
+    DMA2_Stream0->CR = (0u << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_PL_1 | DMA_SxCR_MSIZE_0 |
+                       DMA_SxCR_PSIZE_0 | DMA_SxCR_MINC | DMA_SxCR_CIRC |
+                       DMA_SxCR_HTIE | DMA_SxCR_TCIE;
+    NVIC_SetVector(DMA2_Stream0_IRQn, (uint32_t)analogDmaIsr);
+    NVIC_EnableIRQ(DMA2_Stream0_IRQn);
+#if ANALOG_WATCHDOG
+    NVIC_SetVector(ADC_IRQn, (uint32_t)analogWatchdogIsr);
+    NVIC_EnableIRQ(ADC_IRQn);
+#endif
+    DMA2_Stream0->CR |= DMA_SxCR_EN;
+
+    ADC1->CR2 = ADC_CR2_DMA | ADC_CR2_DDS | ADC_CR2_EXTEN_0 |
+                ((uint32_t)ANALOG_TIM2_TRGO << ADC_CR2_EXTSEL_Pos) | ADC_CR2_ADON;
+
+    // TIM2 runs at twice PCLK1 as APB1 is divided, counts at 1 MHz
+    TIM2->PSC = HAL_RCC_GetPCLK1Freq() * 2 / 1000000 - 1;
+    TIM2->ARR = 1000000 / ANALOG_SCAN_HZ - 1;
+    TIM2->CR2 = TIM_CR2_MMS_1;                      // Update event is TRGO
+    TIM2->EGR = TIM_EGR_UG;
+    TIM2->CR1 = TIM_CR1_CEN;
+
+    sleep_manager_lock_deep_sleep();
+}
+
+// notify runs in interrupt context whenever an analog sensor becomes active or inactive
+void analogNotifyAttach(analogNotify_t notify)
+{
+    analogNotify = notify;
+}
+
+// handler runs in interrupt context on every block, before the thresholds are
+// checked, and must be done with it within one block time
+void analogBlockAttach(analogBlockHandler_t handler)
+{
+    analogBlockHandler = handler;
+}
+
+// Snapshot bits of the analog sensors at or above their thresholds, with hysteresis
+inputMask_t analogActive()
+{
+    return analogActiveSensors;
+}
+
+// Latest block average of an analog sensor, 0 for a digital one
+unsigned int analogMillivoltsRead(int sensor)
+{
+    for (int rank = 0; rank < ANALOG_CHANNELS; rank++) {
+        if (analogRanks.sensors[rank] == sensor) {
+            return analogLevels[rank] * ANALOG_VREF_MV / ANALOG_FULL_SCALE;
+        }
+    }
+    return 0;
+}
+
+//=====[Implementations of private functions]==================================
+
+static constexpr uint16_t millivoltsToCounts(unsigned int millivolts)
+{
+    return (uint16_t)(millivolts * ANALOG_FULL_SCALE / ANALOG_VREF_MV);
+}
+
+// Runs in interrupt context on a block the DMA has finished with
+static void analogBlockProcess(const uint16_t* block)
+{
+    inputMask_t active = analogActiveSensors;
+
+    if (analogBlockHandler != nullptr) {
+        analogBlockHandler(block);
+    }
+    for (int rank = 0; rank < ANALOG_CHANNELS; rank++) {
+        const sensor_t* sensor = &sensors[analogRanks.sensors[rank]];
+        inputMask_t bit = (inputMask_t)1 << analogRanks.sensors[rank];
+        uint32_t sum = 0;
+
+        for (int scan = 0; scan < ANALOG_BLOCK_SCANS; scan++) {
+            sum += block[scan * ANALOG_CHANNELS + rank];
+        }
+        uint16_t level = (uint16_t)(sum / ANALOG_BLOCK_SCANS);
+
+        analogLevels[rank] = level;
+        if (level >= millivoltsToCounts(sensor->thresholdMv)) {
+            active |= bit;
+        } else if (level < millivoltsToCounts(sensor->thresholdMv - sensor->hysteresisMv)) {
+            active &= ~bit;
+        }
+    }
+
+    core_util_critical_section_enter();
+    inputMask_t changed = active ^ analogActiveSensors;
+    analogActiveSensors = active;
+#if ANALOG_WATCHDOG
+    if (!(active & ((inputMask_t)1 << analogRanks.sensors[0]))) {
+        ADC1->CR1 |= ADC_CR1_AWDIE;     // Below the hysteresis again, watch for the next rise
+    }
+#endif
+    core_util_critical_section_exit();
+
+    if (changed != 0 && analogNotify != nullptr) {
+        analogNotify();
+    }
+}
+
+static void analogDmaIsr()
+{
+    uint32_t status = DMA2->LISR;
+
+    DMA2->LIFCR = DMA_LIFCR_CHTIF0 | DMA_LIFCR_CTCIF0 | DMA_LIFCR_CTEIF0 |
+                  DMA_LIFCR_CDMEIF0 | DMA_LIFCR_CFEIF0;
+    if (status & DMA_LISR_HTIF0) {
+        analogBlockProcess(&analogBuffer[0]);
+    }
+    if (status & DMA_LISR_TCIF0) {
+        analogBlockProcess(&analogBuffer[ANALOG_BLOCK_LENGTH]);
+    }
+}
+
+#if ANALOG_WATCHDOG
+// A single conversion above the threshold trips the sensor straight away; the
+// watchdog is masked until the block averages have seen it fall back below
+// the hysteresis, so a level sitting above the threshold raises one interrupt
+static void analogWatchdogIsr()
+{
+    if (ADC1->SR & ADC_SR_AWD) {
+        ADC1->SR = ~ADC_SR_AWD;
+        ADC1->CR1 &= ~ADC_CR1_AWDIE;
+        analogActiveSensors = analogActiveSensors | ((inputMask_t)1 << analogRanks.sensors[0]);
+        if (analogNotify != nullptr) {
+            analogNotify();
+        }
+    }
+}
+#endif
+
+#endif
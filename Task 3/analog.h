@@ -0,0 +1,35 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _ANALOG_H_
+#define _ANALOG_H_
+
+//=====[Libraries]=============================================================
+
+#include <stdint.h>
+
+#include "inputs.h"
+
+//=====[Declaration of public defines]=========================================
+
+#define ANALOG_SCAN_HZ          1000
+#define ANALOG_BLOCK_SCANS      32      // Scans averaged per threshold check, 32 ms
+
+//=====[Declaration of public data types]======================================
+
+typedef void (*analogNotify_t)();
+
+// Receives each block of ANALOG_BLOCK_SCANS scans of raw 12 bit conversions,
+// SENSOR_ANALOG_COUNT per scan in ascending sensor order
+typedef void (*analogBlockHandler_t)(const uint16_t* block);
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+void analogInit();
+void analogNotifyAttach(analogNotify_t notify);
+void analogBlockAttach(analogBlockHandler_t handler);
+inputMask_t analogActive();
+unsigned int analogMillivoltsRead(int sensor);
+
+//=====[#include guards - end]=================================================
+
+#endif // _ANALOG_H_
@@ -0,0 +1,105 @@
+//=====[Libraries]=============================================================
+
+#include "mbed.h"
+#include "arm_book_lib.h"
+
+#include "boot.h"
+#include "serial_tx.h"
+#include "text_format.h"
+
+//=====[Declaration of private defines]========================================
+
+#define BOOT_LINE_LENGTH        144
+
+//=====[Declaration and initialization of private global variables]============
+
+static uint32_t stageCycles[BOOT_STAGES];   // DWT count when each stage was reached, 0 before
+static uint32_t cyclesPerUs = 1;
+static bool startedAtReset = false;         // TargetBSP_Init() started the counter
+
+static const char* const stageNames[BOOT_STAGES] = {
+    "main ",
+    "alarm ",
+    "console ",
+    "log ",
+    "complete ",
+};
+
+//=====[Declarations (prototypes) of private functions]========================
+
+static void cycleCounterStart();
+
+//=====[Implementations of public functions]===================================
+
+// mbed_sdk_init() calls this STM32 hook, empty in mbed-os, once the system
+// clock is set up and before the C++ constructors, the RTOS and main(). The
+// stage times count from here, so they leave out only the reset handler and
+// the clock set-up. The DWT cycle counter runs at the core clock and wraps
+// after about 23 s.
+extern "C" void TargetBSP_Init()
+{
+    cycleCounterStart();
+    startedAtReset = true;
+}
+
+// First thing in main(). Without the hook above the times count from here.
+void bootInit()
+{
+    if (!startedAtReset) {
+        cycleCounterStart();
+    }
+    bootMark(BOOT_MAIN);
+}
+
+void bootMark(bootStage_t stage)
+{
+    if (stageCycles[stage] == 0) {
+        stageCycles[stage] = DWT->CYCCNT | 1;  // Never 0, which stands for not reached yet
+    }
+}
+
+// Microseconds from the counter start to the stage, 0 while it has not been reached
+uint32_t bootStageUs(bootStage_t stage)
+{
+    return stageCycles[stage] / cyclesPerUs;
+}
+
+// Sends "Boot, since reset: main <n> us, alarm <n> us, console <n> us,
+// log <n> us, complete <n> us", with "pending" for a stage not reached yet
+void bootSend()
+{
+    char line[BOOT_LINE_LENGTH];
+    size_t length = 0;
+
+    if (startedAtReset) {
+        length += literalAppend(&line[length], "Boot, since reset: ");
+    } else {
+        length += literalAppend(&line[length], "Boot, since main(): ");
+    }
+    for (int i = 0; i < BOOT_STAGES; i++) {
+        if (i > 0) {
+            length += literalAppend(&line[length], ", ");
+        }
+        length += textAppend(&line[length], stageNames[i]);
+        if (stageCycles[i] == 0) {
+            length += literalAppend(&line[length], "pending");
+        } else {
+            length += decimalWrite(&line[length], bootStageUs((bootStage_t)i));
+            length += literalAppend(&line[length], " us");
+        }
+    }
+    length += literalAppend(&line[length], "\r\n");
+    serialTxWrite(line, length, TX_NEVER_DROP);
+}
+
+//=====[Implementations of private functions]==================================
+
+// Cleared here, as a reset other than power on leaves the DWT running. The
+// profile module times with the same counter.
+static void cycleCounterStart()
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    cyclesPerUs = SystemCoreClock / 1000000;
+}
@@ -0,0 +1,32 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _BOOT_H_
+#define _BOOT_H_
+
+//=====[Libraries]=============================================================
+
+#include <stdint.h>
+
+//=====[Declaration of public data types]======================================
+
+// The boot stages in the order they are reached. Only the first two run
+// before the event loop, the others are deferred behind it.
+typedef enum {
+    BOOT_MAIN,                  // main() entered, the C library and mbed start-up done
+    BOOT_ALARM_READY,           // Inputs sensed and the alarm LED driven
+    BOOT_CONSOLE_READY,         // Command line receiving and reports running
+    BOOT_LOG_READY,             // Flash log scanned, saved state restored, code entry enabled
+    BOOT_COMPLETE,              // Network and streaming started, help banner sent
+    BOOT_STAGES
+} bootStage_t;
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+void bootInit();
+void bootMark(bootStage_t stage);
+uint32_t bootStageUs(bootStage_t stage);
+void bootSend();
+
+//=====[#include guards - end]=================================================
+
+#endif // _BOOT_H_
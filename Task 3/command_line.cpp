@@ -0,0 +1,115 @@
+//=====[Libraries]=============================================================
+
+#include "mbed.h"
+#include "arm_book_lib.h"
+
+#include "command_line.h"
+#include "serial_tx.h"
+
+//=====[Declaration of private defines]========================================
+
+#define COMMAND_LINE_LENGTH     64
+
+//=====[Declaration and initialization of private global variables]============
+
+static const command_t* commandTable = nullptr;
+static int commandCount = 0;
+static commandHandler_t commandUnknown = nullptr;
+
+static char line[COMMAND_LINE_LENGTH];
+static int lineLength = 0;
+static bool lineOverflow = false;       // Rest of an overlong line is being discarded
+
+//=====[Declarations (prototypes) of private functions]========================
+
+static void commandLineExecute();
+static bool isBlank(char c);
+
+//=====[Implementations of public functions]===================================
+
+// unknownHandler receives lines whose first word matches no command
+void commandLineInit(const command_t* commands, int numberOfCommands,
+                     commandHandler_t unknownHandler)
+{
+    commandTable = commands;
+    commandCount = numberOfCommands;
+    commandUnknown = unknownHandler;
+    lineLength = 0;
+    lineOverflow = false;
+}
+
+// Builds a line from the received characters and runs it on CR or LF. Blank
+// lines, so also the second half of CR LF, are ignored.
+void commandLineProcess(char receivedChar)
+{
+    switch (receivedChar) {
+        case '\r':
+        case '\n':
+            if (lineOverflow) {
+                serialTxWriteLiteral("Command too long\r\n", TX_NEVER_DROP);
+            } else {
+                commandLineExecute();
+            }
+            lineLength = 0;
+            lineOverflow = false;
+            break;
+        case '\b':
+        case 0x7F:                      // Backspace or delete from a terminal
+            if (lineLength > 0) {
+                lineLength--;
+            }
+            break;
+        default:
+            if (lineLength < COMMAND_LINE_LENGTH - 1) {
+                line[lineLength++] = receivedChar;
+            } else {
+                lineOverflow = true;
+            }
+            break;
+    }
+}
+
+//=====[Implementations of private functions]==================================
+
+// Splits the line into blank separated words and calls the matching handler
+static void commandLineExecute()
+{
+    char* argv[COMMAND_MAX_ARGUMENTS];
+    int argc = 0;
+    int i = 0;
+
+    line[lineLength] = '\0';
+    while (i < lineLength && argc < COMMAND_MAX_ARGUMENTS) {
+        while (i < lineLength && isBlank(line[i])) {
+            line[i++] = '\0';
+        }
+        if (i < lineLength) {
+            argv[argc++] = &line[i];
+        }
+        while (i < lineLength && !isBlank(line[i])) {
+            i++;
+        }
+    }
+    if (i < lineLength) {
+        line[i] = '\0';                 // Words past the last argument are dropped
+    }
+
+    if (argc == 0) {
+        return;
+    }
+    for (int c = 0; c < commandCount; c++) {
+        if (strcmp(argv[0], commandTable[c].name) == 0 ||
+            (commandTable[c].alias != nullptr && strcmp(argv[0], commandTable[c].alias) == 0)) {
+            commandTable[c].handler(argc, argv);
+            return;
+        }
+    }
+    if (commandUnknown != nullptr) {
+        commandUnknown(argc, argv);
+    }
+}
+
+static bool isBlank(char c)
+{
+    return c == ' ' || c == '\t';
+}
@@ -0,0 +1,28 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _COMMAND_LINE_H_
+#define _COMMAND_LINE_H_
+
+//=====[Declaration of public defines]=========================================
+
+#define COMMAND_MAX_ARGUMENTS   4       // Command name included
+
+//=====[Declaration of public data types]======================================
+
+typedef void (*commandHandler_t)(int argc, char* argv[]);
+
+typedef struct {
+    const char* name;
+    const char* alias;                  // Short form, nullptr if none
+    commandHandler_t handler;
+} command_t;
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+void commandLineInit(const command_t* commands, int numberOfCommands,
+                     commandHandler_t unknownHandler);
+void commandLineProcess(char receivedChar);
+
+//=====[#include guards - end]=================================================
+
+#endif // _COMMAND_LINE_H_
@@ -0,0 +1,18 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _CRC_H_
+#define _CRC_H_
+
+//=====[Libraries]=============================================================
+
+#include <stddef.h>
+#include <stdint.h>
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+uint16_t crc16Ccitt(const uint8_t* data, size_t length);
+uint16_t crc16Modbus(const uint8_t* data, size_t length);
+
+//=====[#include guards - end]=================================================
+
+#endif // _CRC_H_
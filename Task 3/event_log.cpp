@@ -0,0 +1,147 @@
+//=====[Libraries]=============================================================
+
+#include "mbed.h"
+#include "arm_book_lib.h"
+
+#include "event_log.h"
+#include "serial_tx.h"
+#include "text_format.h"
+
+//=====[Declaration of private defines]========================================
+
+#define EVENT_LINE_LENGTH       48
+
+//=====[Declaration of private data types]=====================================
+
+// Timestamps are us_ticker microseconds, which wrap after about 71 minutes
+typedef struct {
+    uint32_t timestamp;
+    uint8_t type;
+    uint8_t value;
+} eventEntry_t;
+
+//=====[Declaration and initialization of private global variables]============
+
+// Written from interrupts and handlers alike, so a slot is claimed and filled
+// inside one short critical section. When the ring is full the oldest entry
+// is overwritten: the events leading up to an incident are the ones we want.
+static eventEntry_t eventRing[EVENT_LOG_SIZE];
+static uint32_t eventHead = 0;          // Total events recorded, masked on access
+
+static uint32_t sendNext = 0;           // Next entry eventLogSendStep() sends
+static uint32_t sendHead = 0;           // eventHead when the dump started
+
+static constexpr const char* eventNames[EVENT_TYPES] = {
+    " sensor on ",
+    " sensor off ",
+    " alarm ",
+    " code ",
+    " lockout ",
+    " boot ",
+    " state ",
+    " code set ",
+    " admin refused ",
+};
+
+static constexpr bool eventNamesFit()
+{
+    for (const char* name : eventNames) {
+        size_t length = 0;
+        while (name[length] != '\0') {
+            length++;
+        }
+        if (length > EVENT_NAME_MAX_LENGTH) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(eventNamesFit(), "An event name is longer than EVENT_NAME_MAX_LENGTH");
+
+//=====[Implementations of public functions]===================================
+
+void eventLogInit()
+{
+    eventHead = 0;
+    eventLogRecord(EVENT_BOOT, 0);
+}
+
+// Safe to call from interrupt context: no I/O, just a timestamped RAM write
+void eventLogRecord(eventType_t type, uint8_t value)
+{
+    eventLogRecordAt(type, value, us_ticker_read());
+}
+
+// For an event that happened before it could be logged, timestamp in us_ticker
+// time. Entries stay in the order they were logged, so the dump can show a
+// debounced edge older than the entry before it.
+void eventLogRecordAt(eventType_t type, uint8_t value, uint32_t timestamp)
+{
+    core_util_critical_section_enter();
+    eventEntry_t* entry = &eventRing[eventHead & (EVENT_LOG_SIZE - 1)];
+    entry->timestamp = timestamp;
+    entry->type = (uint8_t)type;
+    entry->value = value;
+    eventHead++;
+    core_util_critical_section_exit();
+}
+
+// Starts a dump of the log, oldest first, one "[LOG] <us> <event> <value>" line
+// per entry, sent by eventLogSendStep(). Events recorded during the dump are
+// left for the next one.
+void eventLogSendStart()
+{
+    char line[EVENT_LINE_LENGTH];
+    size_t length = 0;
+
+    core_util_critical_section_enter();
+    sendHead = eventHead;
+    core_util_critical_section_exit();
+
+    sendNext = sendHead > EVENT_LOG_SIZE ? sendHead - EVENT_LOG_SIZE : 0;
+
+    length += literalAppend(&line[length], "[LOG] ");
+    length += decimalWrite(&line[length], sendHead - sendNext);
+    length += literalAppend(&line[length], " events, ");
+    length += decimalWrite(&line[length], sendNext);
+    length += literalAppend(&line[length], " overwritten\r\n");
+    serialTxWrite(line, length, TX_NEVER_DROP);
+}
+
+// Sends the lines that fit the TX ring now, true once the dump is done. Each
+// entry is copied out in a critical section so it is never seen half written.
+bool eventLogSendStep()
+{
+    char line[EVENT_LINE_LENGTH];
+
+    for (; sendNext != sendHead && serialTxRoom(EVENT_LINE_LENGTH); sendNext++) {
+        core_util_critical_section_enter();
+        eventEntry_t entry = eventRing[sendNext & (EVENT_LOG_SIZE - 1)];
+        bool overwritten = eventHead - sendNext > EVENT_LOG_SIZE;
+        core_util_critical_section_exit();
+
+        if (overwritten) {
+            continue;                   // Lapped by new events while transmitting
+        }
+
+        size_t length = 0;
+        length += literalAppend(&line[length], "[LOG] ");
+        length += decimalWrite(&line[length], entry.timestamp);
+        length += literalAppend(&line[length], " us");
+        const char* name = eventLogName((eventType_t)entry.type);
+        size_t nameLength = strlen(name);
+        memcpy(&line[length], name, nameLength);
+        length += nameLength;
+        length += decimalWrite(&line[length], entry.value);
+        length += literalAppend(&line[length], "\r\n");
+        serialTxWrite(line, length, TX_NEVER_DROP);
+    }
+    return sendNext == sendHead;
+}
+
+// Event name with a space either side, ready to go between two fields
+const char* eventLogName(eventType_t type)
+{
+    return type < EVENT_TYPES ? eventNames[type] : " ? ";
+}
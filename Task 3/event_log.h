@@ -0,0 +1,41 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _EVENT_LOG_H_
+#define _EVENT_LOG_H_
+
+//=====[Libraries]=============================================================
+
+#include <stdint.h>
+
+//=====[Declaration of public defines]=========================================
+
+#define EVENT_LOG_SIZE          128     // Entries kept, must be a power of two
+#define EVENT_NAME_MAX_LENGTH   15      // Longest eventLogName(), both spaces included
+
+//=====[Declaration of public data types]======================================
+
+typedef enum {
+    EVENT_SENSOR_ON,            // value: index in sensors[], debounced, timed at the edge
+    EVENT_SENSOR_OFF,           // value: index in sensors[], debounced, timed at the edge
+    EVENT_ALARM,                // value: ON or OFF
+    EVENT_CODE_ATTEMPT,         // value: 1 for the correct code, 0 for an incorrect one
+    EVENT_LOCKOUT,              // value: number of incorrect codes, 0 for the unlock command
+    EVENT_BOOT,                 // value: 0
+    EVENT_STATE,                // value: alarmLogicState_t entered
+    EVENT_CODE_SET,             // value: 0, the code itself is never logged
+    EVENT_ADMIN_REFUSED,        // value: adminAction_t refused for a wrong or missing secret
+    EVENT_TYPES
+} eventType_t;
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+void eventLogInit();
+void eventLogRecord(eventType_t type, uint8_t value);
+void eventLogRecordAt(eventType_t type, uint8_t value, uint32_t timestamp);
+void eventLogSendStart();
+bool eventLogSendStep();
+const char* eventLogName(eventType_t type);
+
+//=====[#include guards - end]=================================================
+
+#endif // _EVENT_LOG_H_
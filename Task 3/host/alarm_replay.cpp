@@ -0,0 +1,472 @@
+//=====[Libraries]=============================================================
+
+#include <algorithm>
+#include <chrono>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "alarm_logic.h"
+#include "report.h"
+#include "telemetry.h"
+
+//=====[Declaration of private defines]========================================
+
+// Host replay of the alarm rules. Each scenario is a list of debounced input
+// snapshots with the ms they were taken at, fed to alarmLogicInputUpdate() in
+// simulated time, so a lockout backoff of minutes replays in microseconds.
+//
+//     make -C host run
+//     host/alarm_replay -n 1000 host/traces/gas_chatter.trace
+//
+// A trace file has one "<ms> <snapshot>" line per debounced change, the
+// snapshot in hex with the sensors in bits 0 to 15 and the code buttons in
+// INPUT_A_BUTTON to INPUT_ENTER_BUTTON. Lines starting with # are comments.
+//
+// The totals of one pass are checked against the expected results of the
+// scenario: for a trace, the "<key> <value>" lines of the .expected file next
+// to it, keys as in replayResultKeys[]. Any mismatch, or a p99 latency over
+// p99_ns, fails the run with exit status 1.
+
+#define REPLAY_REPEATS          200     // Passes over each scenario, -n to change
+#define REPLAY_LINE_LENGTH      128
+#define REPLAY_P99_LIMIT_NS     20000   // Latency limit of the built in scenarios
+
+// Bytes main.cpp writes for what an update did, kept in step with it:
+// eventLogRecord() stores an eventEntry_t and stateEventRecord() also
+// programs a persistRecord_t. The status frames and the warnings come from
+// the report module, as on the board.
+#define LOG_ENTRY_BYTES         8
+#define PERSIST_RECORD_BYTES    16
+
+// The default sensor table of sensors.h: D2 is gas, D3 is temperature
+#define SENSOR_GAS_BIT          (1 << 0)
+#define SENSOR_TEMPERATURE_BIT  (1 << 1)
+#define REPLAY_SENSOR_COUNT     2
+
+//=====[Declaration of private data types]=====================================
+
+typedef struct {
+    uint32_t ms;                // Simulated time the snapshot was debounced at
+    inputMask_t inputs;
+} replayStep_t;
+
+typedef struct {
+    uint32_t events;            // Input updates and lockout expiries decided
+    uint32_t transitions;
+    uint32_t logBytes;
+    uint32_t persistBytes;
+    uint32_t reportBytes;
+    uint32_t warnings;          // Warnings sent, onsets and repeats
+    uint32_t warningBytes;
+} replayTotals_t;
+
+typedef struct {
+    const char* name;
+    std::vector<replayStep_t> steps;
+    bool checked;               // expected and p99LimitNs are set
+    replayTotals_t expected;
+    uint32_t p99LimitNs;
+} replayScenario_t;
+
+typedef struct {
+    const char* key;
+    size_t offset;              // Of the total in replayTotals_t
+} replayResultKey_t;
+
+//=====[Declaration and initialization of private constants]===================
+
+static const replayResultKey_t replayResultKeys[] = {
+    { "events",        offsetof(replayTotals_t, events) },
+    { "transitions",   offsetof(replayTotals_t, transitions) },
+    { "log",           offsetof(replayTotals_t, logBytes) },
+    { "flash",         offsetof(replayTotals_t, persistBytes) },
+    { "report",        offsetof(replayTotals_t, reportBytes) },
+    { "warnings",      offsetof(replayTotals_t, warnings) },
+    { "warning_bytes", offsetof(replayTotals_t, warningBytes) },
+};
+
+#define REPLAY_RESULT_KEYS      ((int)(sizeof(replayResultKeys) / sizeof(replayResultKeys[0])))
+
+// As in sensors[] of sensors.h
+static const char* const sensorWarningTexts[REPLAY_SENSOR_COUNT] = {
+    "[WARNING] Gas levels unsafe!",
+    "[WARNING] Temperature too high!",
+};
+
+//=====[Declaration and initialization of private global variables]============
+
+static replayTotals_t totals;   // Of the pass being replayed
+
+//=====[Declarations (prototypes) of private functions]========================
+
+static bool scenarioReplay(const replayScenario_t* scenario, int repeats);
+static bool resultsCheck(const replayScenario_t* scenario, uint32_t p99Ns);
+static void replayPass(const replayScenario_t* scenario, std::vector<uint32_t>* latencies);
+static void eventsCount(alarmLogicEvents_t events);
+static void warningsUpdate(reportWarning_t* warnings, inputMask_t active, inputMask_t previous, uint32_t ms);
+static void warningCount(reportWarning_t* warnings, int sensor, uint32_t ms);
+static void transitionCount(alarmLogicState_t from, alarmLogicState_t to, alarmLogicTrigger_t trigger);
+static bool traceRead(const char* path, replayScenario_t* scenario);
+static bool expectedRead(const char* tracePath, replayScenario_t* scenario);
+static void scenariosBuild(std::vector<replayScenario_t>* scenarios);
+static void codePress(std::vector<replayStep_t>* steps, uint32_t* ms, inputMask_t sensors, inputMask_t code);
+
+//=====[Main function, the program entry point after power on or reset]========
+
+int main(int argc, char* argv[])
+{
+    std::vector<replayScenario_t> scenarios;
+    int repeats = REPLAY_REPEATS;
+    int i = 1;
+
+    if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+        repeats = atoi(argv[i + 1]);
+        i += 2;
+    }
+    if (repeats <= 0) {
+        fprintf(stderr, "usage: %s [-n repeats] [trace ...]\n", argv[0]);
+        return 2;
+    }
+    if (i == argc) {
+        scenariosBuild(&scenarios);
+    }
+    for (; i < argc; i++) {
+        replayScenario_t scenario;
+
+        if (!traceRead(argv[i], &scenario)) {
+            return 1;
+        }
+        scenarios.push_back(scenario);
+    }
+
+    bool passed = true;
+
+    printf("%-17s %7s %12s %8s %8s %8s %8s %8s %8s %8s %8s\n", "scenario", "events", "events/s",
+           "min ns", "p50 ns", "p99 ns", "max ns", "log B", "flash B", "report B", "warn B");
+    for (const replayScenario_t& scenario : scenarios) {
+        if (!scenarioReplay(&scenario, repeats)) {
+            passed = false;
+        }
+    }
+    return passed ? 0 : 1;
+}
+
+//=====[Implementations of private functions]==================================
+
+// The latency is of one decision, alarmLogicInputUpdate() and the transition
+// hook. The byte counts are of one pass, every pass decides the same.
+// Returns false when the scenario does not match its expected results.
+static bool scenarioReplay(const replayScenario_t* scenario, int repeats)
+{
+    std::vector<uint32_t> latencies;
+
+    latencies.reserve(scenario->steps.size() * repeats);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; i++) {
+        replayPass(scenario, &latencies);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (latencies.empty()) {
+        printf("%-17s %7d\n", scenario->name, 0);
+        return resultsCheck(scenario, 0);
+    }
+    std::sort(latencies.begin(), latencies.end());
+    uint32_t p99Ns = latencies[latencies.size() * 99 / 100];
+    printf("%-17s %7u %12.0f %8u %8u %8u %8u %8u %8u %8u %8u\n", scenario->name, totals.events,
+           latencies.size() / seconds, latencies.front(), latencies[latencies.size() / 2],
+           p99Ns, latencies.back(), totals.logBytes, totals.persistBytes, totals.reportBytes,
+           totals.warningBytes);
+    return resultsCheck(scenario, p99Ns);
+}
+
+// Compares the totals of the last pass with the expected ones, printing
+// each difference
+static bool resultsCheck(const replayScenario_t* scenario, uint32_t p99Ns)
+{
+    bool passed = true;
+
+    if (!scenario->checked) {
+        printf("%-17s no expected results, not checked\n", scenario->name);
+        return true;
+    }
+    for (int i = 0; i < REPLAY_RESULT_KEYS; i++) {
+        uint32_t expected = *(const uint32_t*)((const char*)&scenario->expected + replayResultKeys[i].offset);
+        uint32_t actual = *(const uint32_t*)((const char*)&totals + replayResultKeys[i].offset);
+
+        if (actual != expected) {
+            printf("%-17s FAIL %s %u, expected %u\n", scenario->name, replayResultKeys[i].key,
+                   actual, expected);
+            passed = false;
+        }
+    }
+    if (p99Ns > scenario->p99LimitNs) {
+        printf("%-17s FAIL p99 %u ns, limit %u ns\n", scenario->name, p99Ns, scenario->p99LimitNs);
+        passed = false;
+    }
+    return passed;
+}
+
+// Starts from power on with the default code. A lockout expires, as
+// lockoutJob would end it, once the simulated time passes its backoff.
+static void replayPass(const replayScenario_t* scenario, std::vector<uint32_t>* latencies)
+{
+    alarmLogic_t alarm;
+    reportWarning_t warnings[REPLAY_SENSOR_COUNT] = {};
+    inputMask_t previous = 0;
+    uint8_t lastStatus = 0;
+    uint32_t lockoutEndMs = 0;
+
+    memset(&totals, 0, sizeof(totals));
+    alarmLogicInit(&alarm, false, 0, ALARM_CODE_DEFAULT);
+    alarmLogicHookAttach(&alarm, transitionCount);
+
+    for (const replayStep_t& step : scenario->steps) {
+        alarmLogicEvents_t events;
+
+        if (alarmLogicLockout(&alarm) && step.ms >= lockoutEndMs) {
+            auto start = std::chrono::steady_clock::now();
+            events = alarmLogicLockoutExpire(&alarm);
+            latencies->push_back((uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 std::chrono::steady_clock::now() - start).count());
+            eventsCount(events);
+        }
+
+        // The repeats warningRepeatJob sends while the sensors of the last
+        // snapshot stay active, at their due time rather than the next 100 ms check
+        for (inputMask_t m = previous & INPUT_SENSORS; m != 0; m &= m - 1) {
+            int sensor = inputLowest(m);
+
+            while (sensor < REPLAY_SENSOR_COUNT &&
+                   warnings[sensor].lastSentMs + WARNING_REPEAT_MS < step.ms) {
+                warningCount(warnings, sensor, warnings[sensor].lastSentMs + WARNING_REPEAT_MS);
+            }
+        }
+
+        inputMask_t changed = step.inputs ^ previous;
+        auto start = std::chrono::steady_clock::now();
+        events = alarmLogicInputUpdate(&alarm, step.inputs, changed);
+        latencies->push_back((uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now() - start).count());
+
+        totals.logBytes += __builtin_popcount(changed & INPUT_SENSORS) * LOG_ENTRY_BYTES;
+        eventsCount(events);
+        if (events & ALARM_LOGIC_LOCKOUT) {
+            lockoutEndMs = step.ms + alarmLogicLockoutMs(&alarm);
+        }
+        uint8_t status = reportStatusBits(alarm.alarmState, step.inputs,
+                                          SENSOR_GAS_BIT, SENSOR_TEMPERATURE_BIT);
+        if (status != lastStatus) {
+            totals.reportBytes += reportFrames[status].length;
+            lastStatus = status;
+        }
+        warningsUpdate(warnings, step.inputs & INPUT_SENSORS, previous & INPUT_SENSORS, step.ms);
+        previous = step.inputs;
+    }
+}
+
+// One stateEventRecord() per record alarmEventsRecord() makes for these events
+static void eventsCount(alarmLogicEvents_t events)
+{
+    int records = __builtin_popcount(events & (ALARM_LOGIC_CODE_INCORRECT | ALARM_LOGIC_LOCKOUT |
+                                               ALARM_LOGIC_UNLOCKED | ALARM_LOGIC_ACTIVATED));
+
+    if (events & ALARM_LOGIC_DEACTIVATED) {
+        records += 2;               // The code attempt and the alarm going off
+    }
+    totals.events++;
+    totals.logBytes += records * LOG_ENTRY_BYTES;
+    totals.persistBytes += records * PERSIST_RECORD_BYTES;
+}
+
+// sendWarningIfNeeded() after a debounced change, for the sensors of the
+// default table
+static void warningsUpdate(reportWarning_t* warnings, inputMask_t active, inputMask_t previous, uint32_t ms)
+{
+    for (inputMask_t m = active; m != 0; m &= m - 1) {
+        int sensor = inputLowest(m);
+
+        if (sensor < REPLAY_SENSOR_COUNT &&
+            reportWarningDue(&warnings[sensor], !(previous & ((inputMask_t)1 << sensor)), ms)) {
+            warningCount(warnings, sensor, ms);
+        }
+    }
+}
+
+// warningSend() in text mode
+static void warningCount(reportWarning_t* warnings, int sensor, uint32_t ms)
+{
+    char buffer[WARNING_MAX_LENGTH];
+
+    totals.warnings++;
+    totals.warningBytes += reportWarningWrite(&warnings[sensor], sensorWarningTexts[sensor], buffer);
+    reportWarningSent(&warnings[sensor], ms);
+}
+
+// alarmTransitionLog() logs the state entered
+static void transitionCount(alarmLogicState_t, alarmLogicState_t, alarmLogicTrigger_t)
+{
+    totals.transitions++;
+    totals.logBytes += LOG_ENTRY_BYTES;
+}
+
+static bool traceRead(const char* path, replayScenario_t* scenario)
+{
+    FILE* file = fopen(path, "r");
+    char line[REPLAY_LINE_LENGTH];
+    int lineNumber = 0;
+
+    if (file == nullptr) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return false;
+    }
+    *scenario = {};
+    const char* slash = strrchr(path, '/');
+    scenario->name = slash != nullptr ? slash + 1 : path;
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        unsigned long ms;
+        unsigned long inputs;
+
+        lineNumber++;
+        if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') {
+            continue;
+        }
+        if (sscanf(line, "%lu %lx", &ms, &inputs) != 2 || (inputs >> INPUT_BITS) != 0) {
+            fprintf(stderr, "%s:%d: expected \"<ms> <hex snapshot>\"\n", path, lineNumber);
+            fclose(file);
+            return false;
+        }
+        scenario->steps.push_back({ (uint32_t)ms, (inputMask_t)inputs });
+    }
+    fclose(file);
+    return expectedRead(path, scenario);
+}
+
+// Reads <trace>.expected, the .trace suffix replaced, if there is one. Every
+// key of replayResultKeys[] and p99_ns must be given.
+static bool expectedRead(const char* tracePath, replayScenario_t* scenario)
+{
+    char path[REPLAY_LINE_LENGTH * 2];
+    char line[REPLAY_LINE_LENGTH];
+    size_t length = strlen(tracePath);
+    bool found[REPLAY_RESULT_KEYS] = {};
+    bool limitFound = false;
+    int lineNumber = 0;
+
+    if (length >= 6 && strcmp(&tracePath[length - 6], ".trace") == 0) {
+        length -= 6;
+    }
+    snprintf(path, sizeof(path), "%.*s.expected", (int)length, tracePath);
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        return true;                    // Replayed without a check
+    }
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        char key[32];
+        unsigned long value;
+        bool known = false;
+
+        lineNumber++;
+        if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') {
+            continue;
+        }
+        if (sscanf(line, "%31s %lu", key, &value) == 2) {
+            for (int i = 0; i < REPLAY_RESULT_KEYS; i++) {
+                if (strcmp(key, replayResultKeys[i].key) == 0) {
+                    *(uint32_t*)((char*)&scenario->expected + replayResultKeys[i].offset) = (uint32_t)value;
+                    found[i] = known = true;
+                }
+            }
+            if (strcmp(key, "p99_ns") == 0) {
+                scenario->p99LimitNs = (uint32_t)value;
+                limitFound = known = true;
+            }
+        }
+        if (!known) {
+            fprintf(stderr, "%s:%d: expected \"<key> <value>\"\n", path, lineNumber);
+            fclose(file);
+            return false;
+        }
+    }
+    fclose(file);
+    for (int i = 0; i < REPLAY_RESULT_KEYS; i++) {
+        if (!found[i]) {
+            fprintf(stderr, "%s: no %s\n", path, replayResultKeys[i].key);
+            return false;
+        }
+    }
+    if (!limitFound) {
+        fprintf(stderr, "%s: no p99_ns\n", path);
+        return false;
+    }
+    scenario->checked = true;
+    return true;
+}
+
+// Synthetic traces for the cases the rules have to keep up with: a chattering
+// detector, both detectors in turn, clearing the alarm, and a brute force run
+// of wrong codes through the lockout backoff. The expected totals are in
+// replayTotals_t order and assume the default ALARM_LOCKOUT_* and WARNING_* settings.
+static void scenariosBuild(std::vector<replayScenario_t>* scenarios)
+{
+    replayScenario_t chatter = { "gas chatter", {}, true,
+                                 { 1000, 1, 8016, 16, 67000, 50, 2235 }, REPLAY_P99_LIMIT_NS };
+    replayScenario_t both = { "both sensors", {}, true,
+                              { 1000, 1, 8016, 16, 66000, 500, 15750 }, REPLAY_P99_LIMIT_NS };
+    replayScenario_t clear = { "code clear", {}, true,
+                               { 1400, 600, 12800, 9600, 40200, 200, 6000 }, REPLAY_P99_LIMIT_NS };
+    replayScenario_t bruteForce = { "wrong codes", {}, true,
+                                    { 1405, 34, 392, 208, 130, 1, 33 }, REPLAY_P99_LIMIT_NS };
+    uint32_t ms = 0;
+
+    for (int i = 0; i < 1000; i++) {
+        chatter.steps.push_back({ ms += 50, (i & 1) ? 0u : SENSOR_GAS_BIT });
+    }
+
+    ms = 0;
+    for (int i = 0; i < 250; i++) {
+        both.steps.push_back({ ms += 400, SENSOR_GAS_BIT });
+        both.steps.push_back({ ms += 400, SENSOR_GAS_BIT | SENSOR_TEMPERATURE_BIT });
+        both.steps.push_back({ ms += 400, SENSOR_TEMPERATURE_BIT });
+        both.steps.push_back({ ms += 400, 0 });
+    }
+
+    ms = 0;
+    for (int i = 0; i < 200; i++) {
+        clear.steps.push_back({ ms += 1000, SENSOR_GAS_BIT });
+        clear.steps.push_back({ ms += 2000, 0 });
+        codePress(&clear.steps, &ms, 0, ALARM_CODE_DEFAULT);
+    }
+
+    ms = 0;
+    bruteForce.steps.push_back({ ms += 1000, SENSOR_TEMPERATURE_BIT });
+    bruteForce.steps.push_back({ ms += 1000, 0 });
+    for (int i = 0; i < 200; i++) {
+        codePress(&bruteForce.steps, &ms, 0, INPUT_C_BUTTON | INPUT_D_BUTTON);
+        bruteForce.steps.push_back({ ms += 200, INPUT_CODE_BUTTONS });  // Acknowledge it
+        bruteForce.steps.push_back({ ms += 200, 0 });
+    }
+
+    scenarios->push_back(chatter);
+    scenarios->push_back(both);
+    scenarios->push_back(clear);
+    scenarios->push_back(bruteForce);
+}
+
+// Holds the code buttons one at a time, presses and releases Enter, then
+// lets go of the buttons, 200 ms between debounced changes
+static void codePress(std::vector<replayStep_t>* steps, uint32_t* ms, inputMask_t sensors, inputMask_t code)
+{
+    inputMask_t held = sensors;
+
+    for (inputMask_t m = code; m != 0; m &= m - 1) {
+        held |= (inputMask_t)1 << inputLowest(m);
+        steps->push_back({ *ms += 200, held });
+    }
+    steps->push_back({ *ms += 200, held | INPUT_ENTER_BUTTON });
+    steps->push_back({ *ms += 200, held });
+    steps->push_back({ *ms += 200, sensors });
+}
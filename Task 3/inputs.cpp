@@ -0,0 +1,313 @@
+//=====[Libraries]=============================================================
+
+#include "mbed.h"
+#include "arm_book_lib.h"
+
+#include "alarm_config.h"
+#include "analog.h"
+#include "inputs.h"
+#include "low_power.h"
+#include "sensors.h"
+
+//=====[Declaration of private defines]========================================
+
+#define INPUT_PORT_COUNT        3
+#define INPUT_BUTTON_COUNT      (INPUT_BITS - INPUT_SENSOR_LIMIT)
+
+//=====[Declaration of private data types]=====================================
+
+typedef struct {
+    PinName pin;                // NC for a snapshot bit with no input
+    PinMode mode;
+    uint16_t debounceMs;
+} inputPin_t;
+
+typedef struct {
+    inputPin_t pins[INPUT_BITS];
+} inputPinTable_t;
+
+//=====[Declaration and initialization of private global variables]============
+
+// Code entry buttons, in snapshot order from INPUT_A_BUTTON
+static constexpr inputPin_t buttonPins[INPUT_BUTTON_COUNT] = {
+    { D4,      PullDown, BUTTON_DEBOUNCE_MS },  // INPUT_A_BUTTON
+    { D5,      PullDown, BUTTON_DEBOUNCE_MS },  // INPUT_B_BUTTON
+    { D6,      PullDown, BUTTON_DEBOUNCE_MS },  // INPUT_C_BUTTON
+    { D7,      PullDown, BUTTON_DEBOUNCE_MS },  // INPUT_D_BUTTON
+    { BUTTON1, PullNone, BUTTON_DEBOUNCE_MS },  // INPUT_ENTER_BUTTON, pulled down on the board
+};
+
+// GPIO ports holding the input pins on the Nucleo-F439ZI
+static constexpr PortName inputPorts[INPUT_PORT_COUNT] = { PortC, PortE, PortF };
+
+static inputMask_t debouncedInputs = 0;
+static inputMask_t pendingInputs = 0;   // Raw level differs from the debounced one
+static Kernel::Clock::time_point pendingSince[INPUT_BITS];
+static uint32_t changeUs[INPUT_BITS];   // us_ticker time the pending or last accepted change started
+
+#if ALARM_EVENT_DRIVEN
+static gpio_irq_t sensorIrqs[SENSOR_COUNT];
+static inputSensorIsr_t sensorIsr = nullptr;
+static volatile uint32_t sensorEdgeUs[SENSOR_COUNT];  // Latest EXTI edge of each digital sensor
+static inputMask_t timedInputs = 0;     // Sensors whose changes are timed by their interrupt
+#endif
+
+//=====[Declarations (prototypes) of private functions]========================
+
+static inputMask_t inputsSample();
+static uint32_t changeStartUs(int input, uint32_t sampleUs);
+static constexpr uint32_t inputPortMask(PortName port);
+static constexpr int inputPortIndex(PinName pin);
+static constexpr bool inputPinsOnPorts();
+static constexpr bool sensorExtiLinesFree();
+#if ALARM_EVENT_DRIVEN
+static void sensorIrqHandler(uint32_t id, gpio_irq_event);
+#endif
+
+//=====[Declaration and initialization of private constants]===================
+
+// Indexed by bit position in the snapshot, built by the compiler from sensors[] and buttonPins[]
+static constexpr inputPinTable_t inputPinTableBuild()
+{
+    inputPinTable_t table = {};
+
+    for (int i = 0; i < INPUT_BITS; i++) {
+        table.pins[i] = { NC, PullNone, 0 };
+    }
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        table.pins[i] = { sensors[i].analog ? NC : sensors[i].pin, PullDown, sensors[i].debounceMs };
+    }
+    for (int i = 0; i < INPUT_BUTTON_COUNT; i++) {
+        table.pins[INPUT_SENSOR_LIMIT + i] = buttonPins[i];
+    }
+    return table;
+}
+
+static constexpr inputPinTable_t inputPins = inputPinTableBuild();
+
+static constexpr inputMask_t inputsUsed()
+{
+    inputMask_t mask = 0;
+
+    for (int i = 0; i < INPUT_BITS; i++) {
+        if (inputPins.pins[i].pin != NC) {
+            mask |= (inputMask_t)1 << i;
+        }
+    }
+    return mask;
+}
+
+static constexpr inputMask_t INPUT_USED = inputsUsed();
+
+//=====[Declaration and initialization of public global objects]===============
+
+// Each port is read with a single IDR access, so all inputs are sampled together
+PortIn inputPortC(PortC, inputPortMask(PortC));
+PortIn inputPortE(PortE, inputPortMask(PortE));
+PortIn inputPortF(PortF, inputPortMask(PortF));
+
+//=====[Implementations of public functions]===================================
+
+void inputsInit()
+{
+    for (inputMask_t m = INPUT_USED; m != 0; m &= m - 1) {
+        int i = inputLowest(m);
+        pin_mode(inputPins.pins[i].pin, inputPins.pins[i].mode);  // Pull-down for stable sensor and button inputs
+    }
+
+    debouncedInputs = inputsSample();   // Levels at power on are taken as they are
+    pendingInputs = 0;
+    uint32_t now = us_ticker_read();
+    for (int i = 0; i < INPUT_BITS; i++) {
+        changeUs[i] = now;
+    }
+#if ALARM_ANALOG
+    analogInit();                       // Analog sensors join the snapshot after their first block
+#endif
+}
+
+#if ALARM_EVENT_DRIVEN
+// isr runs in interrupt context on both edges of every digital sensor, each on
+// an EXTI line of its own, and on every analog threshold crossing. The code
+// entry buttons have no interrupts, as EXTI 13 is shared by BUTTON1 (PC_13),
+// D7 (PF_13) and D3 (PE_13), and are polled only while needed.
+void inputsSensorIrqAttach(inputSensorIsr_t isr)
+{
+    sensorIsr = isr;
+#if ALARM_ANALOG
+    analogNotifyAttach(isr);            // Threshold crossings wake the handler like an edge
+#endif
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        if (sensors[i].analog) {
+            continue;
+        }
+        timedInputs |= (inputMask_t)1 << i;
+        gpio_irq_init(&sensorIrqs[i], sensors[i].pin, sensorIrqHandler, i);
+        gpio_irq_set(&sensorIrqs[i], IRQ_RISE, 1);
+        gpio_irq_set(&sensorIrqs[i], IRQ_FALL, 1);
+        gpio_irq_enable(&sensorIrqs[i]);
+    }
+}
+#endif
+
+// Samples every input once and runs the time based debounce: a new level is
+// accepted once every sample over the input's debounce time has agreed with it.
+// Returns the debounced bits that changed, see inputsChangeUs() for when.
+inputMask_t inputsUpdate()
+{
+    Kernel::Clock::time_point now = Kernel::Clock::now();
+    uint32_t sampleUs = us_ticker_read();
+    inputMask_t differing = inputsSample() ^ debouncedInputs;
+#if ALARM_ANALOG
+    differing = (differing & ~INPUT_ANALOG_SENSORS) | ((analogActive() ^ debouncedInputs) & INPUT_ANALOG_SENSORS);
+#endif
+    inputMask_t accepted = 0;
+
+    for (inputMask_t m = differing; m != 0; m &= m - 1) {  // Inputs back at their debounced level need no work
+        int i = inputLowest(m);
+        inputMask_t bit = (inputMask_t)1 << i;
+
+        if (!(pendingInputs & bit)) {
+            pendingSince[i] = now;      // First sample at the new level
+            changeUs[i] = changeStartUs(i, sampleUs);
+        } else if (now - pendingSince[i] >= std::chrono::milliseconds(inputPins.pins[i].debounceMs)) {
+            accepted |= bit;
+        }
+    }
+
+    debouncedInputs ^= accepted;
+    pendingInputs = differing & ~accepted;
+    return accepted;
+}
+
+// Debounced state of every input, consistent across all the bits
+inputMask_t inputsRead()
+{
+    return debouncedInputs;
+}
+
+// us_ticker time a change returned by the last inputsUpdate() started at, not
+// when the debounce accepted it: the EXTI edge of a sensor with an interrupt,
+// otherwise the first sample at the new level
+uint32_t inputsChangeUs(int input)
+{
+    return changeUs[input];
+}
+
+// True while an input is waiting out its debounce time, so it needs sampling again
+bool inputsSettling()
+{
+    return pendingInputs != 0;
+}
+
+// Inputs whose raw level differs from the debounced one
+inputMask_t inputsPending()
+{
+    return pendingInputs;
+}
+
+//=====[Implementations of private functions]==================================
+
+// Reads each port once, then packs the input bits into snapshot order
+static inputMask_t inputsSample()
+{
+    uint32_t levels[INPUT_PORT_COUNT] = {
+        (uint32_t)inputPortC.read(), (uint32_t)inputPortE.read(), (uint32_t)inputPortF.read()
+    };
+    inputMask_t sample = 0;
+
+    for (inputMask_t m = INPUT_USED; m != 0; m &= m - 1) {
+        int i = inputLowest(m);
+        PinName pin = inputPins.pins[i].pin;
+
+        if (levels[inputPortIndex(pin)] & (1u << STM_PIN(pin))) {
+            sample |= (inputMask_t)1 << i;
+        }
+    }
+    return sample;
+}
+
+static constexpr uint32_t inputPortMask(PortName port)
+{
+    uint32_t mask = 0;
+
+    for (int i = 0; i < INPUT_BITS; i++) {
+        if (inputPins.pins[i].pin != NC && STM_PORT(inputPins.pins[i].pin) == (uint32_t)port) {
+            mask |= 1u << STM_PIN(inputPins.pins[i].pin);
+        }
+    }
+    return mask;
+}
+
+// Position of the pin's port in inputPorts, or -1 if it is not there
+static constexpr int inputPortIndex(PinName pin)
+{
+    for (int i = 0; i < INPUT_PORT_COUNT; i++) {
+        if (STM_PORT(pin) == (uint32_t)inputPorts[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static constexpr bool inputPinsOnPorts()
+{
+    for (int i = 0; i < INPUT_BITS; i++) {
+        if (inputPins.pins[i].pin != NC && inputPortIndex(inputPins.pins[i].pin) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// An EXTI line serves one pin number on one port at a time
+static constexpr bool sensorExtiLinesFree()
+{
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        if (sensors[i].analog) {
+            continue;
+        }
+        for (int j = i + 1; j < SENSOR_COUNT; j++) {
+            if (!sensors[j].analog && STM_PIN(sensors[i].pin) == STM_PIN(sensors[j].pin)) {
+                return false;
+            }
+        }
+#if ALARM_LOW_POWER
+        if (STM_PIN(sensors[i].pin) >= LOW_POWER_EXTI_FIRST &&
+            STM_PIN(sensors[i].pin) <= LOW_POWER_EXTI_LAST) {
+            return false;               // Their vector is the UART RX wake-up's
+        }
+#endif
+    }
+    return true;
+}
+
+#if ALARM_EVENT_DRIVEN
+// Runs in interrupt context
+static void sensorIrqHandler(uint32_t id, gpio_irq_event)
+{
+    sensorEdgeUs[id] = us_ticker_read();    // Before the debounce delays it
+    if (sensorIsr != nullptr) {
+        sensorIsr();
+    }
+}
+#endif
+
+// The latest edge before the first sample at the new level is the one the
+// change started with. An edge after the sample is already the next change.
+static uint32_t changeStartUs(int input, uint32_t sampleUs)
+{
+#if ALARM_EVENT_DRIVEN
+    if (timedInputs & ((inputMask_t)1 << input)) {
+        uint32_t edgeUs = sensorEdgeUs[input];
+
+        if ((int32_t)(sampleUs - edgeUs) >= 0) {
+            return edgeUs;
+        }
+    }
+#endif
+    return sampleUs;
+}
+
+static_assert(inputPinsOnPorts(), "Every input pin must be on one of inputPorts");
+static_assert(sensorExtiLinesFree(), "Every sensor needs an EXTI line of its own");
@@ -0,0 +1,51 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _INPUTS_H_
+#define _INPUTS_H_
+
+//=====[Libraries]=============================================================
+
+#include <stdint.h>
+
+//=====[Declaration of public defines]=========================================
+
+// Bits of an input snapshot: the sensors listed in sensors.h take bits 0 to
+// INPUT_SENSOR_LIMIT - 1 in table order, the code entry buttons the bits above
+#define INPUT_SENSOR_LIMIT      16
+#define INPUT_A_BUTTON          (1 << (INPUT_SENSOR_LIMIT + 0))
+#define INPUT_B_BUTTON          (1 << (INPUT_SENSOR_LIMIT + 1))
+#define INPUT_C_BUTTON          (1 << (INPUT_SENSOR_LIMIT + 2))
+#define INPUT_D_BUTTON          (1 << (INPUT_SENSOR_LIMIT + 3))
+#define INPUT_ENTER_BUTTON      (1 << (INPUT_SENSOR_LIMIT + 4))
+#define INPUT_BITS              (INPUT_SENSOR_LIMIT + 5)
+
+#define INPUT_SENSORS           ((1 << INPUT_SENSOR_LIMIT) - 1)
+#define INPUT_CODE_BUTTONS      (INPUT_A_BUTTON | INPUT_B_BUTTON | INPUT_C_BUTTON | INPUT_D_BUTTON)
+
+//=====[Declaration of public data types]======================================
+
+typedef uint32_t inputMask_t;
+typedef void (*inputSensorIsr_t)();
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+void inputsInit();
+void inputsSensorIrqAttach(inputSensorIsr_t isr);
+inputMask_t inputsUpdate();
+inputMask_t inputsRead();
+uint32_t inputsChangeUs(int input);
+bool inputsSettling();
+inputMask_t inputsPending();
+
+//=====[Implementations of public inline functions]============================
+
+// Bit position of the lowest input in a mask, for walking only the set bits:
+// for (inputMask_t m = mask; m != 0; m &= m - 1) { int i = inputLowest(m); ... }
+inline int inputLowest(inputMask_t mask)
+{
+    return __builtin_ctz(mask);
+}
+
+//=====[#include guards - end]=================================================
+
+#endif // _INPUTS_H_
@@ -0,0 +1,100 @@
+//=====[Libraries]=============================================================
+
+#include "mbed.h"
+#include "arm_book_lib.h"
+
+#include "alarm_config.h"
+#include "leds.h"
+
+//=====[Declaration of private defines]========================================
+
+#define PATTERN_STEADY(pattern)     ((pattern) == LED_PATTERN_OFF || (pattern) == LED_PATTERN_ON)
+
+//=====[Declaration and initialization of private global variables]============
+
+static DigitalOut ledPins[LEDS] = {
+    DigitalOut(LED1),
+    DigitalOut(LED3),
+    DigitalOut(LED2),
+};
+
+// Written by ledPatternWrite() from the alarm thread, read by the ticker.
+// A pin is only written when its level changes.
+static volatile ledPattern_t patterns[LEDS];
+static bool levels[LEDS];
+static unsigned int step = 0;
+
+// The ticker only runs while a pattern is blinking, so steady LEDs cost no
+// wake-ups at all. The low power build keeps deep sleep with a LowPowerTicker.
+#if ALARM_LOW_POWER
+static LowPowerTicker stepTicker;
+#else
+static Ticker stepTicker;
+#endif
+static bool stepTickerRunning = false;
+
+//=====[Declarations (prototypes) of private functions]========================
+
+static void ledStep();
+static void ledLevelWrite(int led, bool level);
+
+//=====[Implementations of public functions]===================================
+
+void ledsInit()
+{
+    for (int led = 0; led < LEDS; led++) {
+        patterns[led] = LED_PATTERN_OFF;
+        levels[led] = OFF;
+        ledPins[led] = OFF;
+    }
+}
+
+// Returns at once when the pattern is already showing, so callers can write
+// the pattern they want after every update
+void ledPatternWrite(led_t led, ledPattern_t pattern)
+{
+    bool blinking = false;
+
+    if (patterns[led] == pattern) {
+        return;
+    }
+
+    // The first level shows straight away, in step with the other patterns
+    core_util_critical_section_enter();
+    if (!stepTickerRunning) {
+        step = 0;
+    }
+    patterns[led] = pattern;
+    ledLevelWrite(led, (pattern >> step) & 1);
+    for (int i = 0; i < LEDS; i++) {
+        blinking = blinking || !PATTERN_STEADY(patterns[i]);
+    }
+    core_util_critical_section_exit();
+
+    if (blinking && !stepTickerRunning) {
+        stepTicker.attach(ledStep, std::chrono::milliseconds(LED_STEP_MS));
+        stepTickerRunning = true;
+    } else if (!blinking && stepTickerRunning) {
+        stepTicker.detach();
+        stepTickerRunning = false;
+    }
+}
+
+//=====[Implementations of private functions]==================================
+
+// Runs in interrupt context every LED_STEP_MS while a pattern is blinking
+static void ledStep()
+{
+    step = (step + 1) % LED_PATTERN_STEPS;
+    for (int led = 0; led < LEDS; led++) {
+        ledLevelWrite(led, (patterns[led] >> step) & 1);
+    }
+}
+
+static void ledLevelWrite(int led, bool level)
+{
+    if (levels[led] != level) {
+        levels[led] = level;
+        ledPins[led] = level;
+    }
+}
@@ -0,0 +1,41 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _LEDS_H_
+#define _LEDS_H_
+
+//=====[Libraries]=============================================================
+
+#include <stdint.h>
+
+//=====[Declaration of public defines]=========================================
+
+// A pattern is one bit per LED_STEP_MS step, bit 0 first, repeated every
+// LED_PATTERN_STEPS steps (1.6 s)
+#define LED_STEP_MS             50
+#define LED_PATTERN_STEPS       32
+
+#define LED_PATTERN_OFF         0x00000000u
+#define LED_PATTERN_ON          0xFFFFFFFFu
+#define LED_PATTERN_BLINK_SLOW  0x0000FFFFu     // 0.8 s on, 0.8 s off
+#define LED_PATTERN_BLINK_FAST  0x33333333u     // 100 ms on, 100 ms off
+#define LED_PATTERN_PULSE       0x00000003u     // 100 ms flash every 1.6 s
+
+//=====[Declaration of public data types]======================================
+
+typedef enum {
+    LED_ALARM,                  // LED1
+    LED_INCORRECT_CODE,         // LED3 (not relevant to Task 3)
+    LED_SYSTEM_BLOCKED,         // LED2 (not relevant to Task 3)
+    LEDS
+} led_t;
+
+typedef uint32_t ledPattern_t;
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+void ledsInit();
+void ledPatternWrite(led_t led, ledPattern_t pattern);
+
+//=====[#include guards - end]=================================================
+
+#endif // _LEDS_H_
@@ -0,0 +1,135 @@
+//=====[Libraries]=============================================================
+
+#include "mbed.h"
+#include "arm_book_lib.h"
+
+#include "low_power.h"
+#include "serial_tx.h"
+#include "text_format.h"
+
+//=====[Declaration of private defines]========================================
+
+// The USART3 RX pin of the ST-LINK virtual COM port (USBRX, PD_9) cannot wake the
+// F439ZI from stop mode, but its EXTI line can, as EXTI still sees the pin while
+// it is in alternate function mode. inputs.cpp keeps the sensors off EXTI lines
+// LOW_POWER_EXTI_FIRST to LOW_POWER_EXTI_LAST, which share the vector.
+#define RX_WAKE_EXTI_MASK       EXTI_IMR_MR9
+
+// Typical supply currents used for the current estimate, taken from the F439ZI
+// datasheet at 180 MHz with peripherals enabled. Adjust for the board in use.
+#define RUN_CURRENT_UA          60000
+#define SLEEP_CURRENT_UA        25000
+#define DEEP_SLEEP_CURRENT_UA   400
+
+#define STATS_MAX_LENGTH        128
+
+//=====[Declaration and initialization of private global variables]============
+
+static lowPowerRxWakeCallback_t rxWake = nullptr;
+
+static volatile unsigned int wakeupCount = 0;
+static unsigned int lastWakeupCount = 0;
+static Kernel::Clock::time_point lastStatsTime;  // Statistics are counted from power on at first
+#if MBED_CPU_STATS_ENABLED
+static mbed_stats_cpu_t lastCpuStats;
+#endif
+
+//=====[Declarations (prototypes) of private functions]========================
+
+static void rxWakeIrqHandler();
+
+//=====[Implementations of public functions]===================================
+
+// Routes the RX pin to its EXTI line, falling edge (start bit), initially masked.
+// rxWakeCallback runs in interrupt context when the line fires.
+void lowPowerInit(lowPowerRxWakeCallback_t rxWakeCallback)
+{
+    rxWake = rxWakeCallback;
+
+    RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+    SYSCFG->EXTICR[2] = (SYSCFG->EXTICR[2] & ~SYSCFG_EXTICR3_EXTI9) | SYSCFG_EXTICR3_EXTI9_PD;
+    EXTI->IMR &= ~RX_WAKE_EXTI_MASK;
+    EXTI->RTSR &= ~EXTI_RTSR_TR9;
+    EXTI->FTSR |= EXTI_FTSR_TR9;
+    EXTI->PR = EXTI_PR_PR9;
+
+    NVIC_SetVector(EXTI9_5_IRQn, (uint32_t)rxWakeIrqHandler);
+    NVIC_ClearPendingIRQ(EXTI9_5_IRQn);
+    NVIC_EnableIRQ(EXTI9_5_IRQn);
+}
+
+// Call after detaching the UART RX interrupt, which holds the deep sleep lock.
+// The character whose start bit wakes the board is lost.
+void lowPowerRxWakeArm()
+{
+    EXTI->PR = EXTI_PR_PR9;
+    EXTI->IMR |= RX_WAKE_EXTI_MASK;
+}
+
+// Called from every interrupt or timeout that wakes the firmware
+void lowPowerWakeupCount()
+{
+    wakeupCount++;
+}
+
+// Sends the wake-ups and the time spent running, sleeping and in deep sleep since
+// the previous query, with the average current those figures imply
+void lowPowerStatsSend()
+{
+    char buffer[STATS_MAX_LENGTH];
+    size_t length = 0;
+    Kernel::Clock::time_point now = Kernel::Clock::now();
+    unsigned int elapsedMs = (unsigned int)(now - lastStatsTime).count();
+    unsigned int wakeups = wakeupCount - lastWakeupCount;
+
+    length += literalAppend(&buffer[length], "Wake-ups: ");
+    length += decimalWrite(&buffer[length], wakeups);
+    length += literalAppend(&buffer[length], " in ");
+    length += decimalWrite(&buffer[length], elapsedMs / 1000);
+    length += literalAppend(&buffer[length], " s (");
+    length += decimalTenthsWrite(&buffer[length],
+                                 elapsedMs ? (unsigned int)((uint64_t)wakeups * 10000 / elapsedMs) : 0);
+    length += literalAppend(&buffer[length], "/s)");
+
+#if MBED_CPU_STATS_ENABLED
+    mbed_stats_cpu_t cpuStats;
+    mbed_stats_cpu_get(&cpuStats);
+
+    uint64_t uptime = cpuStats.uptime - lastCpuStats.uptime;
+    uint64_t sleep = cpuStats.sleep_time - lastCpuStats.sleep_time;
+    uint64_t deepSleep = cpuStats.deep_sleep_time - lastCpuStats.deep_sleep_time;
+    uint64_t run = uptime - sleep - deepSleep;
+    lastCpuStats = cpuStats;
+
+    if (uptime > 0) {
+        length += literalAppend(&buffer[length], ", run ");
+        length += decimalTenthsWrite(&buffer[length], (unsigned int)(run * 1000 / uptime));
+        length += literalAppend(&buffer[length], "%, sleep ");
+        length += decimalTenthsWrite(&buffer[length], (unsigned int)(sleep * 1000 / uptime));
+        length += literalAppend(&buffer[length], "%, deep sleep ");
+        length += decimalTenthsWrite(&buffer[length], (unsigned int)(deepSleep * 1000 / uptime));
+        length += literalAppend(&buffer[length], "%, est. ");
+        length += decimalWrite(&buffer[length],
+                               (unsigned int)((run * RUN_CURRENT_UA + sleep * SLEEP_CURRENT_UA +
+                                               deepSleep * DEEP_SLEEP_CURRENT_UA) / uptime));
+        length += literalAppend(&buffer[length], " uA");
+    }
+#endif
+    length += literalAppend(&buffer[length], "\r\n");
+
+    lastWakeupCount += wakeups;
+    lastStatsTime = now;
+    serialTxWrite(buffer, length, TX_NEVER_DROP);
+}
+
+//=====[Implementations of private functions]==================================
+
+static void rxWakeIrqHandler()
+{
+    EXTI->PR = EXTI_PR_PR9;
+    EXTI->IMR &= ~RX_WAKE_EXTI_MASK;    // UART RX interrupt takes over again
+    wakeupCount++;
+    if (rxWake != nullptr) {
+        rxWake();
+    }
+}
@@ -0,0 +1,26 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _LOW_POWER_H_
+#define _LOW_POWER_H_
+
+//=====[Declaration of public defines]=========================================
+
+// lowPowerInit() takes the whole EXTI9_5 vector for the UART RX wake-up, so
+// these lines cannot serve a sensor interrupt in the low power build
+#define LOW_POWER_EXTI_FIRST    5
+#define LOW_POWER_EXTI_LAST     9
+
+//=====[Declaration of public data types]======================================
+
+typedef void (*lowPowerRxWakeCallback_t)();
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+void lowPowerInit(lowPowerRxWakeCallback_t rxWakeCallback);
+void lowPowerRxWakeArm();
+void lowPowerWakeupCount();
+void lowPowerStatsSend();
+
+//=====[#include guards - end]=================================================
+
+#endif // _LOW_POWER_H_
@@ -3,169 +3,1614 @@
 #include "mbed.h"
 #include "arm_book_lib.h"
 
+#include "alarm_config.h"
+#include "alarm_logic.h"
+#include "analog.h"
+#include "boot.h"
+#include "command_line.h"
+#include "event_log.h"
+#include "inputs.h"
+#include "leds.h"
+#include "low_power.h"
+#include "modbus.h"
+#include "network.h"
+#include "persist.h"
+#include "profile.h"
+#include "report.h"
+#include "scheduler.h"
+#include "sensors.h"
+#include "serial_rx.h"
+#include "serial_tx.h"
+#include "stream.h"
+#include "supervisor.h"
+#include "system_state.h"
+#include "telemetry.h"
+#include "text_format.h"
+#include "threads.h"
+
+//=====[Declaration of private defines]========================================
+#define RX_AWAKE_MS             2000    // Low power: UART RX interrupt is released this long after the last character
+#define INPUT_SAMPLE_MS         5       // Sample period while an input is waiting out its debounce time
+
+#define LOOP_PERIOD_MS          100     // Polling pass period, also the warning check and code entry poll period
+#define REPORT_PERIOD_MS        5000    // [Requirement (ii), (iii)]: Default status report period
+#define REPORT_PERIOD_MAX_S     3600    // Longest report period that can be set with the period command
+#define REPORT_HEARTBEAT_MS     60000   // Report period while reporting on change
+#define PERSIST_FLUSH_MS        200     // Batches the boot records and polls a running sector erase
+#define TEXT_JOB_MS             20      // Refills the TX ring while a long reply is sent, 230 bytes at 115200 baud
+
+#define EVENT_QUEUE_SIZE        16      // Number of events that can be pending in eventQueue
+
+// Modbus register map, the same for holding and input registers. 0 to 15 and
+// the analog levels are read only, writes to them are refused.
+#define MODBUS_REG_STATUS           0   // STATUS_*_BIT flags, lockout included
+#define MODBUS_REG_SENSORS          1   // Active sensors, bit n for sensors[n]
+#define MODBUS_REG_INCORRECT_CODES  2
+#define MODBUS_REG_SEQUENCE         3   // Changes with every alarm state update
+#define MODBUS_REG_REQUESTS         4   // modbusCounters_t, low 16 bits
+#define MODBUS_REG_CRC_ERRORS       5
+#define MODBUS_REG_OVERRUNS         6
+#define MODBUS_REG_EXCEPTIONS       7
+#define MODBUS_REG_ANALOG           16  // mV of each analog sensor, in sensors[] order
+#define MODBUS_REG_UNLOCK           32  // Write MODBUS_UNLOCK_KEY to run the unlock command, not by broadcast
+
+//=====[Declaration of private data types]=====================================
+// Value of an EVENT_ADMIN_REFUSED record
+typedef enum {
+    ADMIN_UNLOCK,               // unlock command
+    ADMIN_CODE,                 // code command
+    ADMIN_MODBUS_UNLOCK,        // Modbus unlock register, wrong key
+} adminAction_t;
+
 //=====[Declaration and initialization of public global objects]===============
-// Define input pins for sensors and buttons
-DigitalIn enterButton(BUTTON1);         // Enter button for potential future use (not relevant to Task 3)
-DigitalIn gasDetector(D2);              // Gas detector input pin
-DigitalIn overTempDetector(D3);         // Over-temperature detector input pin
-DigitalIn aButton(D4);                  // Code entry buttons (not relevant to Task 3)
-DigitalIn bButton(D5);
-DigitalIn cButton(D6);
-DigitalIn dButton(D7);
-
-// Define output pins for LEDs
-DigitalOut alarmLed(LED1);              // LED to indicate alarm state
-DigitalOut incorrectCodeLed(LED3);      // LED for incorrect code indication (not relevant to Task 3)
-DigitalOut systemBlockedLed(LED2);      // LED for lockout indication (not relevant to Task 3)
+// Input pins for sensors and buttons are in the inputs module, LED pins in the leds module
 
 // UART object for serial communication with PC at 115200 baud
 UnbufferedSerial uartUsb(USBTX, USBRX, 115200);  // [Requirement (i), (ii), (iii), (iv)]: Sets up UART for all communication tasks
 
-// Timer to track periodic report interval
-Timer reportTimer;  // [Requirement (ii), (iii)]: Used to manage periodic status reports every 5 seconds
+#if ALARM_EVENT_DRIVEN
+// Queue that runs all handlers in thread context, fed by the sensor and UART RX interrupts
+EventQueue eventQueue(EVENT_QUEUE_SIZE * EVENTS_EVENT_SIZE);
+#endif
+#if ALARM_THREADED
+// eventQueue is left with the alarm and input handlers. Commands and reports
+// run from queues of their own, on lower priority threads.
+EventQueue commandQueue(EVENT_QUEUE_SIZE * EVENTS_EVENT_SIZE);
+EventQueue reportQueue(EVENT_QUEUE_SIZE * EVENTS_EVENT_SIZE);
+#endif
 
 //=====[Declaration and initialization of public global variables]=============+
-bool alarmState = OFF;                  // Tracks alarm state (relevant for periodic and continuous reporting)
-int numberOfIncorrectCodes = 0;         // Tracks incorrect code attempts (not relevant to Task 3)
+alarmLogic_t alarmSystem = { ALARM_STATE_IDLE, OFF, OFF, OFF, 0, ALARM_CODE_DEFAULT, nullptr };  // Alarm and code entry state, see alarm_logic for the rules
+
+//=====[Declaration and initialization of private global variables]============
+static unsigned int reportPeriodMs = REPORT_PERIOD_MS;  // Periodic report interval, set over UART
+static bool reportOnChange = false;     // Report on every status change plus a slow heartbeat
+static uint8_t lastReportedStatus = 0;  // STATUS_*_BIT flags sent in the last report
+#if ALARM_NETWORK
+static uint8_t lastPublishedStatus = 0; // STATUS_*_BIT flags of the last report frame published
+#endif
+
+static reportWarning_t sensorWarnings[SENSOR_COUNT];  // Warning rules are in the report module
+static inputMask_t warningsActive = 0;  // Sensors that were active at the previous warning update
+
+static schedulerJob_t reportJob;        // [Requirement (ii), (iii)]: Periodic status report
+static schedulerJob_t persistJob;       // Programs batched log records into flash, runs only while some are pending
+static schedulerJob_t lockoutJob;       // Ends the lockout backoff, runs only while the system is blocked
+static schedulerJob_t textJob;          // Sends a long reply a piece at a time, runs only while one is going out
+#if ALARM_SUPERVISOR
+static schedulerJob_t supervisorJob;    // Checks every deadline and kicks the watchdog
+#endif
+#if ALARM_EVENT_DRIVEN
+static schedulerJob_t warningJob;       // Warning repeat check, runs only while a sensor is active
+static schedulerJob_t inputSampleJob;   // Input sampling, runs only while an input is being debounced
+static schedulerJob_t codeEntryJob;     // Code entry poll, runs only while the alarm or incorrect code LED is on
+
+static volatile bool sensorEventPending = false;  // Coalesces sensor edges into one queued event
+static volatile bool uartEventPending = false;    // Coalesces received characters into one queued event
+static int schedulerEventId = 0;        // eventQueue id of the call that runs the next due job
+static Kernel::Clock::time_point schedulerArmedDeadline;
+#if ALARM_LOW_POWER
+static schedulerJob_t rxAwakeJob;       // Releases the UART RX interrupt once the link is quiet
+#endif
+#else
+static schedulerJob_t pollJob;          // One pass of the polling loop
+#endif
+
+#if ALARM_THREADED
+static volatile bool reportEventPending = false;  // Coalesces published changes into one queued event
+#endif
+
+// Saved state read by the deferred flash scan, merged in by stateRestore()
+static persistState_t restoredState;
+static bool restoredStateValid = false;
+static volatile bool stateRestored = false;  // Code entry and the admin commands wait for the saved lockout and code
+#if !ALARM_EVENT_DRIVEN
+static void (*bootPendingStage)() = nullptr;  // Deferred boot stage the polling loop runs next
+#endif
+
+// The long reply being sent by textJob, its step returns true once all is sent
+static bool (*textJobStep)() = nullptr;
+static volatile bool textJobClaimed = false;  // Taken by the command starting a long reply
+static int helpNext = 0;                    // Next line of helpLines[]
+
+// Sent by availableCommands(), one line per step of the text job
+static const char* const helpLines[] = {
+    "Available commands, each followed by Enter:\r\n",
+    "'1' or 'alarm' to get the alarm state\r\n",
+    "'2' or 'gas' to check gas status\r\n",
+    "'3' or 'temp' to check temperature status\r\n",
+    "'a' or 'all' to get all of the above, incorrect codes and lockout at once\r\n",
+    "'t' or 'text', 'b' or 'binary' for text or binary status reports\r\n",
+    "'p' or 'period' <seconds> to set the report period\r\n",
+    "'c' or 'onchange' [on|off] to set or toggle reporting on change\r\n",
+    "'w' or 'power' to get wake-up and sleep statistics\r\n",
+    "'l' or 'log' to dump the timestamped event log\r\n",
+    "'h' or 'history' to dump the alarm history kept in flash\r\n",
+    "'u' or 'unlock' <secret> to clear the incorrect codes and end a lockout\r\n",
+    "'e' or 'code' <secret> <buttons> to set the deactivation code, e.g. 'code <secret> ab'\r\n",
+#if ALARM_PROFILE || ALARM_SUPERVISOR
+    "'s' or 'stats' to get stage timings, deadline misses and the last reset cause\r\n",
+#endif
+#if ALARM_THREADED
+    "'k' or 'threads' to get the stack high-water mark of every thread\r\n",
+#endif
+#if ANALOG_STREAM
+    "'r' or 'stream' [on|off|<decimation>] to stream raw ADC samples in binary mode\r\n",
+#endif
+#if ALARM_NETWORK
+    "'n' or 'network' to get the Ethernet link state and publish counters\r\n",
+#endif
+    "'o' or 'boot' to get the time from reset to each boot stage\r\n",
+    "\r\n",
+};
+
+#define HELP_LINES              ((int)(sizeof(helpLines) / sizeof(helpLines[0])))
 
 //=====[Declarations (prototypes) of public functions]=========================
-void inputsInit();
 void outputsInit();
 
-void alarmActivationUpdate();
-void alarmDeactivationUpdate();
+void alarmUpdate(inputMask_t changed);
 
 void uartTask();                   // [Requirement (i)]: Handles user input to report sensor states
 void availableCommands();
 void sendStatusReport();          // [Requirement (ii), (iii)]: Sends periodic and continuous status updates
 void sendWarningIfNeeded();       // [Requirement (iv)]: Triggers warnings for unsafe conditions
 
+//=====[Declarations (prototypes) of private functions]========================
+static uint8_t statusBitsRead(const systemState_t* state);
+static unsigned int reportIntervalMs();
+static void reportRestart();
+static void reportJobRestart();
+static void reportThreadRun(void (*function)());
+static bool textJobClaim();
+static void textJobPost(bool (*step)());
+static void textJobBegin(bool (*step)());
+static void textJobRun();
+static bool helpStep();
+static void reportOnChangeUpdate();
+static void reportSettingsSend();
+#if ALARM_NETWORK
+static void reportPublish(uint8_t statusBits);
+#endif
+
+static void commandAlarm(int argc, char* argv[]);
+static void commandGas(int argc, char* argv[]);
+static void commandTemperature(int argc, char* argv[]);
+static void commandQueryAll(int argc, char* argv[]);
+static void commandText(int argc, char* argv[]);
+static void commandBinary(int argc, char* argv[]);
+static void commandPeriod(int argc, char* argv[]);
+static void commandOnChange(int argc, char* argv[]);
+static void commandPower(int argc, char* argv[]);
+static void commandLog(int argc, char* argv[]);
+static void commandHistory(int argc, char* argv[]);
+static void commandUnlock(int argc, char* argv[]);
+static void commandCode(int argc, char* argv[]);
+#if ALARM_PROFILE || ALARM_SUPERVISOR
+static void commandStats(int argc, char* argv[]);
+#endif
+#if ALARM_THREADED
+static void commandThreads(int argc, char* argv[]);
+#endif
+#if ANALOG_STREAM
+static void commandStream(int argc, char* argv[]);
+#endif
+#if ALARM_NETWORK
+static void commandNetwork(int argc, char* argv[]);
+#endif
+static void commandBoot(int argc, char* argv[]);
+static void commandHelp(int argc, char* argv[]);
+static void warningSend(int sensor, uint32_t nowMs);
+static constexpr bool warningsFit();
+static void inputChangesLog(inputMask_t changed);
+static void stateEventRecord(eventType_t type, uint8_t value);
+static void persistFlushJob();
+static void bootStageNext(void (*stage)());
+static void bootConsoleStage();
+static void bootLogStage();
+static void bootRestoreStage();
+static void bootCompleteStage();
+static void stateRestore();
+static void alarmEventsRecord(alarmLogicEvents_t events);
+static void alarmPowerOnUpdate();
+static void alarmTransitionLog(alarmLogicState_t from, alarmLogicState_t to, alarmLogicTrigger_t trigger);
+static void alarmEventsApply(alarmLogicEvents_t events);
+static void alarmLedsUpdate();
+static void alarmChangeApply(alarmLogicEvents_t events);
+static void alarmStatePublish();
+static void lockoutJobUpdate();
+#if ALARM_SUPERVISOR
+static void supervisorRun();
+static void reportCheckIn();
+#if ALARM_THREADED
+static void commandCheckIn();
+#endif
+#endif
+static void lockoutExpireJob();
+static void adminUnlockPost();
+static void adminUnlock();
+static void adminCodeWrite(inputMask_t code);
+static bool adminSecretMatches(const char* text);
+static void adminRefuse(adminAction_t action);
+static void adminNotReady();
+static void adminRefusedRecord(adminAction_t action);
+static bool codeParse(const char* text, inputMask_t* code);
+#if ALARM_MODBUS
+static uint8_t modbusRegisterRead(uint16_t address, uint16_t* value);
+static uint8_t modbusRegisterWrite(uint16_t address, uint16_t value, bool broadcast);
+#endif
+static void statusReportJob();
+static void edgeLatencyUpdate(inputMask_t changed);
+#if ALARM_ANALOG
+static void analogLevelsSend();
+#endif
+
+#if ALARM_EVENT_DRIVEN
+static void eventsInit();
+static void sensorChangeIsr();
+static void uartRxIsr();
+static void sensorChangeHandler();
+static void inputsProcess();
+static void uartRxHandler();
+static void codeEntryPoll();
+static void statusChangeReport();
+static void warningRepeatJob();
+static void periodicEventsUpdate();
+static void schedulerDispatch();
+static void schedulerArm();
+#if ALARM_LOW_POWER
+static void rxAwakeTimeout();
+static void rxWakeIsr();
+static void rxWakeHandler();
+#endif
+#if ALARM_THREADED
+static void statusChangeHandler();
+#endif
+#else
+static void pollingLoopPass();
+#endif
+
+//=====[Declaration and initialization of the UART command table]==============
+// [Requirement (i)]: UART commands, each ended by Enter. The one character aliases
+// keep the original single key commands working.
+static const command_t commands[] = {
+    { "alarm",    "1", commandAlarm },
+    { "gas",      "2", commandGas },
+    { "temp",     "3", commandTemperature },
+    { "all",      "a", commandQueryAll },
+    { "text",     "t", commandText },
+    { "binary",   "b", commandBinary },
+    { "period",   "p", commandPeriod },
+    { "onchange", "c", commandOnChange },
+    { "power",    "w", commandPower },
+    { "log",      "l", commandLog },
+    { "history",  "h", commandHistory },
+    { "unlock",   "u", commandUnlock },
+    { "code",     "e", commandCode },
+#if ALARM_PROFILE || ALARM_SUPERVISOR
+    { "stats",    "s", commandStats },
+#endif
+#if ALARM_THREADED
+    { "threads",  "k", commandThreads },
+#endif
+#if ANALOG_STREAM
+    { "stream",   "r", commandStream },
+#endif
+#if ALARM_NETWORK
+    { "network",  "n", commandNetwork },
+#endif
+    { "boot",     "o", commandBoot },
+    { "help",     "?", commandHelp },
+};
+
 //=====[Main function, the program entry point after power on or reset]========
 int main()
 {
+    // Only what the alarm needs runs before the event loop, so the sensors are
+    // sensed and the alarm LED driven first. The console, the flash log, the
+    // network and the help banner follow as deferred stages, see the 'boot'
+    // command for how long each one took.
+    bootInit();                     // Boot stage times count from reset, see boot.cpp
+    profileInit();                  // Clear the stage statistics when instrumentation is built in
     inputsInit();                   // Initialize input pins
     outputsInit();                  // Initialize output pins
-    reportTimer.start();            // [Requirement (ii), (iii)]: Start timer for periodic status reporting
+    serialTxInit();                 // Start with empty UART TX rings
+    eventLogInit();
+    alarmLogicHookAttach(&alarmSystem, alarmTransitionLog);
+    commandLineInit(commands, sizeof(commands) / sizeof(commands[0]), commandHelp);
+
+    schedulerInit();
+    reportJob = schedulerJobAdd(statusReportJob, reportIntervalMs());
+    persistJob = schedulerJobAdd(persistFlushJob, PERSIST_FLUSH_MS);
+    lockoutJob = schedulerJobAdd(lockoutExpireJob, ALARM_LOCKOUT_BASE_MS);
+    textJob = schedulerJobAdd(textJobRun, TEXT_JOB_MS);
+#if ALARM_SUPERVISOR
+    supervisorInit();               // The flash scan never waits for an erase, so the watchdog covers it
+    supervisorJob = schedulerJobAdd(supervisorRun, SUPERVISOR_PERIOD_MS);
+    schedulerJobStart(supervisorJob);
+#endif
+
+#if ALARM_EVENT_DRIVEN
+    warningJob = schedulerJobAdd(warningRepeatJob, LOOP_PERIOD_MS);
+    inputSampleJob = schedulerJobAdd(inputsProcess, INPUT_SAMPLE_MS);
+    codeEntryJob = schedulerJobAdd(codeEntryPoll, LOOP_PERIOD_MS);
+#if ALARM_LOW_POWER
+    rxAwakeJob = schedulerJobAdd(rxAwakeTimeout, RX_AWAKE_MS);
+#endif
+    eventsInit();                   // Attach the sensor interrupts and run the first alarm update
+    bootMark(BOOT_ALARM_READY);
+    eventQueue.call(bootConsoleStage);
+#if ALARM_THREADED
+    threadsStart(&eventQueue, &commandQueue);
+    reportQueue.dispatch_forever(); // This thread now runs the reports at the lowest priority
+#else
+    eventQueue.dispatch_forever();  // Run handlers as events arrive, sleeping in between
+#endif
+#else
+    pollJob = schedulerJobAdd(pollingLoopPass, LOOP_PERIOD_MS);
+    schedulerJobStart(pollJob);
+    alarmPowerOnUpdate();           // Act on a sensor that is already active at boot
+    bootMark(BOOT_ALARM_READY);
+    bootPendingStage = bootConsoleStage;
 
     while (true) {
-        alarmActivationUpdate();    // Update alarm state (affects reporting)
-        alarmDeactivationUpdate();  // Handle code entry (not relevant to Task 3)
-        uartTask();                 // [Requirement (i)]: Process UART input for sensor state requests
-
-        // [Requirement (ii), (iii)]: Periodically send status report every 5 seconds
-        if (reportTimer.read() >= 5.0f) {
-            sendStatusReport();     // Send alarm, gas, and temperature statuses
-            reportTimer.reset();    // Reset timer for next interval
+        schedulerRun();             // Run the polling pass and the status report when they are due
+        if (bootPendingStage != nullptr) {
+            void (*stage)() = bootPendingStage;
+            bootPendingStage = nullptr;
+            stage();                // One deferred boot stage between two scheduler runs
+            continue;
         }
-
-        sendWarningIfNeeded();      // [Requirement (iv)]: Continuously check and send warnings if needed
-        thread_sleep_for(100);      // Reduce CPU usage to prevent busy-waiting
+        ThisThread::sleep_until(schedulerNextDeadline());  // Sleep exactly until the next deadline
+        lowPowerWakeupCount();
     }
+#endif
 }
 
 //=====[Implementations of public functions]===================================
 
-void inputsInit()
+void outputsInit()
 {
-    gasDetector.mode(PullDown);     // Set gas detector pin to pull-down mode for stable input
-    overTempDetector.mode(PullDown); // Set temperature detector pin to pull-down mode for stable input
-    aButton.mode(PullDown);         // Set code buttons to pull-down (not relevant to Task 3)
-    bButton.mode(PullDown);
-    cButton.mode(PullDown);
-    dButton.mode(PullDown);
+    ledsInit();                     // Initialize all LEDs to OFF
 }
 
-void outputsInit()
+// Runs the alarm state machine on the debounced inputs that just changed.
+// With no change there is nothing for it to do, so it returns at once.
+void alarmUpdate(inputMask_t changed)
 {
-    alarmLed = OFF;                 // Initialize alarm LED to OFF
-    incorrectCodeLed = OFF;         // Initialize incorrect code LED to OFF (not relevant to Task 3)
-    systemBlockedLed = OFF;         // Initialize lockout LED to OFF (not relevant to Task 3)
+    uint32_t start = profileStart();
+
+    if (!stateRestored) {
+        changed &= INPUT_SENSORS;   // A code entered now would be tried against the default code
+    }
+    if (changed == 0) {
+        return;
+    }
+    alarmEventsApply(alarmLogicInputUpdate(&alarmSystem, inputsRead(), changed));
+    profileStageEnd(PROFILE_ALARM, start);
 }
 
-void alarmActivationUpdate()
+// [Requirement (i)]: Handles user input to report sensor states via UART
+void uartTask()
+{
+    uint32_t start = profileStart();
+
+#if ALARM_MODBUS
+    modbusProcess();                       // Answer the request addressed to this node, if one came in
+#else
+    char receivedChar = '\0';  // Variable to store the incoming character from the PC
+
+    while (serialRxRead(&receivedChar)) {  // Handle every character received since the last call
+        commandLineProcess(receivedChar);  // Runs each command as its line is completed
+    }
+#endif
+    profileStageEnd(PROFILE_UART, start);
+}
+
+// Prints list of available UART commands
+// The help text goes out through the text job like the other long replies
+void availableCommands()
+{
+    if (textJobClaim()) {
+        helpNext = 0;
+        textJobPost(helpStep);
+    }
+}
+
+// [Requirement (ii), (iii)]: Sends periodic and continuous status updates every 5 seconds
+void sendStatusReport()
 {
-    if (gasDetector || overTempDetector) {  // Check if gas or temperature sensor is triggered
-        alarmState = ON;                    // Set alarm state to ON (affects periodic/continuous reporting)
+    uint32_t start = profileStart();
+    systemState_t state = systemStateRead();
+    uint8_t statusBits = statusBitsRead(&state);
+
+    lastReportedStatus = statusBits;
+#if ALARM_NETWORK
+    reportPublish(statusBits);              // Also the network heartbeat
+#endif
+    if (telemetryModeRead() == TELEMETRY_BINARY) {
+        telemetryStatusSend(statusBits);    // Compact COBS framed packet for the gateway
+#if ALARM_ANALOG
+        analogLevelsSend();
+#endif
+    } else {
+        const reportFrame_t* frame = &reportFrames[statusBits];
+#if ALARM_ANALOG
+        serialTxWrite(frame->text, frame->length - 2, TX_NEVER_DROP);  // Levels go before the blank line
+        analogLevelsSend();
+        serialTxWriteLiteral("\r\n", TX_NEVER_DROP);
+#else
+        serialTxWrite(frame->text, frame->length, TX_NEVER_DROP);  // Queue the report, it carries the alarm state
+#endif
     }
-    alarmLed = alarmState;                  // Reflect alarm state on LED (visual indicator)
+    profileStageEnd(PROFILE_REPORT, start);
 }
 
-void alarmDeactivationUpdate()
+// [Requirement (iv)]: Sends warning messages while dangerous conditions are detected, rate limited
+void sendWarningIfNeeded()
 {
-    if (numberOfIncorrectCodes < 5) {
-        if (aButton && bButton && cButton && dButton && !enterButton) {
-            incorrectCodeLed = OFF;         // Reset incorrect code LED (not relevant to Task 3)
+    uint32_t start = profileStart();
+    uint32_t nowMs = (uint32_t)Kernel::Clock::now().time_since_epoch().count();
+    inputMask_t active = systemStateRead().sensors;
+
+    for (inputMask_t m = active; m != 0; m &= m - 1) {              // Only sensors indicating unsafe conditions
+        int sensor = inputLowest(m);
+        bool onset = !(warningsActive & ((inputMask_t)1 << sensor));
+
+        if (reportWarningDue(&sensorWarnings[sensor], onset, nowMs)) {
+            warningSend(sensor, nowMs);
         }
-        if (enterButton && !incorrectCodeLed && alarmState) {
-            if (aButton && bButton && !cButton && !dButton) {
-                alarmState = OFF;           // Deactivate alarm (affects reporting)
-                numberOfIncorrectCodes = 0; // Reset counter (not relevant to Task 3)
-            } else {
-                incorrectCodeLed = ON;       // Indicate incorrect code (not relevant to Task 3)
-                numberOfIncorrectCodes++;    // Increment counter (not relevant to Task 3)
-            }
+    }
+    warningsActive = active;
+    profileStageEnd(PROFILE_WARNING, start);
+}
+
+//=====[Implementations of private functions]==================================
+
+static uint8_t statusBitsRead(const systemState_t* state)
+{
+    return reportStatusBits(state->alarmState, state->sensors, INPUT_GAS_DETECTORS, INPUT_OVER_TEMP_DETECTORS);
+}
+
+static unsigned int reportIntervalMs()
+{
+    return reportOnChange ? REPORT_HEARTBEAT_MS : reportPeriodMs;
+}
+
+// Starts the report interval again from now, after a change report or a new setting.
+// The scheduler belongs to the alarm thread, the other threads post the restart there.
+static void reportRestart()
+{
+#if ALARM_THREADED
+    eventQueue.call(reportJobRestart);
+#else
+    reportJobRestart();
+#endif
+}
+
+static void reportJobRestart()
+{
+    schedulerJobPeriodWrite(reportJob, reportIntervalMs());
+    schedulerJobStart(reportJob);
+#if ALARM_THREADED
+    schedulerArm();
+#endif
+}
+
+// Reports, warnings and flash programming are run on the report thread when
+// there is one, so they never hold up an alarm update
+static void reportThreadRun(void (*function)())
+{
+#if ALARM_THREADED
+    reportQueue.call(function);
+#else
+    function();
+#endif
+}
+
+// Long replies, the help text and the log and history dumps, are sent a
+// piece at a time. Each step only writes what fits the TX ring at once, so a
+// dump never holds up the alarm handling and the alarm messages written
+// meanwhile never wait. One long reply at a time: another command asking for
+// one while it is going out is answered busy.
+static bool textJobClaim()
+{
+    core_util_critical_section_enter();
+    bool claimed = !textJobClaimed;
+    textJobClaimed = true;
+    core_util_critical_section_exit();
+
+    if (!claimed) {
+        serialTxWriteLiteral("[BUSY] Still sending the last reply\r\n", TX_NEVER_DROP);
+    }
+    return claimed;
+}
+
+// The scheduler belongs to the alarm thread, the command thread posts the step there
+static void textJobPost(bool (*step)())
+{
+#if ALARM_THREADED
+    eventQueue.call(textJobBegin, step);
+#else
+    textJobBegin(step);
+#endif
+}
+
+static void textJobBegin(bool (*step)())
+{
+    textJobStep = step;
+    textJobRun();
+    if (textJobClaimed && !schedulerJobRunning(textJob)) {
+        schedulerJobStart(textJob);
+#if ALARM_EVENT_DRIVEN
+        schedulerArm();
+#endif
+    }
+}
+
+static void textJobRun()
+{
+    if (textJobStep()) {
+        schedulerJobStop(textJob);
+        textJobStep = nullptr;
+        textJobClaimed = false;
+    }
+}
+
+static bool helpStep()
+{
+    for (; helpNext < HELP_LINES && serialTxRoom(strlen(helpLines[helpNext])); helpNext++) {
+        serialTxWrite(helpLines[helpNext], strlen(helpLines[helpNext]), TX_NEVER_DROP);
+    }
+    return helpNext == HELP_LINES;
+}
+
+static void reportOnChangeUpdate()
+{
+    systemState_t state = systemStateRead();
+
+    if (reportOnChange && statusBitsRead(&state) != lastReportedStatus) {
+        sendStatusReport();
+        reportRestart();            // Heartbeat counts from the last report sent
+    }
+#if ALARM_NETWORK
+    if (statusBitsRead(&state) != lastPublishedStatus) {
+        reportPublish(statusBitsRead(&state));  // The network gets every change, whatever the serial setting
+    }
+#endif
+}
+
+#if ALARM_NETWORK
+// The report frames are constant, so only a pointer to one is queued. A
+// report with a new status is a change, which the network never drops in
+// favour of a heartbeat.
+static void reportPublish(uint8_t statusBits)
+{
+    const reportFrame_t* frame = &reportFrames[statusBits];
+    networkPublishType_t type = statusBits != lastPublishedStatus ? NETWORK_CHANGE : NETWORK_HEARTBEAT;
+
+    lastPublishedStatus = statusBits;
+    networkPublish(frame->text, frame->length, type);
+}
+#endif
+
+// Sends "Report period: <n> s, on change: <on|off>"
+static void reportSettingsSend()
+{
+    char buffer[48];
+    size_t length = 0;
+
+    length += literalAppend(&buffer[length], "Report period: ");
+    length += decimalWrite(&buffer[length], reportPeriodMs / 1000);
+    length += literalAppend(&buffer[length], " s, on change: ");
+    if (reportOnChange) {
+        length += literalAppend(&buffer[length], "on\r\n");
+    } else {
+        length += literalAppend(&buffer[length], "off\r\n");
+    }
+    serialTxWrite(buffer, length, TX_NEVER_DROP);
+}
+
+static void commandAlarm(int argc, char* argv[])
+{
+    if (systemStateRead().alarmState) {
+        serialTxWriteLiteral("The alarm is activated\r\n", TX_NEVER_DROP);
+    } else {
+        serialTxWriteLiteral("The alarm is not activated\r\n", TX_NEVER_DROP);
+    }
+}
+
+// [Requirement (i)]: Report gas detector state
+static void commandGas(int argc, char* argv[])
+{
+    if (systemStateRead().sensors & INPUT_GAS_DETECTORS) {
+        serialTxWriteLiteral("Gas detected!\r\n", TX_NEVER_DROP);  // Send gas state to PC
+    } else {
+        serialTxWriteLiteral("No gas detected\r\n", TX_NEVER_DROP);
+    }
+}
+
+// [Requirement (i)]: Report temperature detector state
+static void commandTemperature(int argc, char* argv[])
+{
+    if (systemStateRead().sensors & INPUT_OVER_TEMP_DETECTORS) {
+        serialTxWriteLiteral("Over temperature detected!\r\n", TX_NEVER_DROP);  // Send temperature state to PC
+    } else {
+        serialTxWriteLiteral("Temperature normal\r\n", TX_NEVER_DROP);
+    }
+}
+
+// Alarm, gas, temperature, incorrect codes, lockout and each sensor in one response,
+// framed like the status reports: "[STATE] alarm=1 gas=0 temp=0 codes=2 lockout=0 sensors=01"
+// in text mode, sensor 0 first, or a TELEMETRY_PACKET_STATE packet in binary mode
+static void commandQueryAll(int argc, char* argv[])
+{
+    systemState_t state = systemStateRead();
+    uint8_t statusBits = statusBitsRead(&state);
+    bool lockout = state.lockout;
+    inputMask_t sensorBits = state.sensors;
+
+    if (telemetryModeRead() == TELEMETRY_BINARY) {
+        telemetryStateSend(statusBits | (lockout ? STATUS_LOCKOUT_BIT : 0),
+                           state.incorrectCodes, (uint16_t)sensorBits);
+        return;
+    }
+
+    char buffer[96];
+    size_t length = 0;
+
+    length += literalAppend(&buffer[length], "[STATE] alarm=");
+    buffer[length++] = (statusBits & STATUS_ALARM_BIT) ? '1' : '0';
+    length += literalAppend(&buffer[length], " gas=");
+    buffer[length++] = (statusBits & STATUS_GAS_BIT) ? '1' : '0';
+    length += literalAppend(&buffer[length], " temp=");
+    buffer[length++] = (statusBits & STATUS_TEMP_BIT) ? '1' : '0';
+    length += literalAppend(&buffer[length], " codes=");
+    length += decimalWrite(&buffer[length], state.incorrectCodes);
+    length += literalAppend(&buffer[length], " lockout=");
+    buffer[length++] = lockout ? '1' : '0';
+    length += literalAppend(&buffer[length], " sensors=");
+    for (int sensor = 0; sensor < SENSOR_COUNT; sensor++) {
+        buffer[length++] = (sensorBits & ((inputMask_t)1 << sensor)) ? '1' : '0';
+    }
+    length += literalAppend(&buffer[length], "\r\n");
+    serialTxWrite(buffer, length, TX_NEVER_DROP);
+}
+
+// Human readable status reports (default)
+static void commandText(int argc, char* argv[])
+{
+    telemetryModeWrite(TELEMETRY_TEXT);
+#if ANALOG_STREAM
+    streamStop();                   // Sample packets would garble a terminal
+#endif
+    serialTxWriteLiteral("Status reports: text\r\n", TX_NEVER_DROP);
+}
+
+// Compact binary status reports for the gateway
+static void commandBinary(int argc, char* argv[])
+{
+    telemetryModeWrite(TELEMETRY_BINARY);
+    serialTxWriteLiteral("Status reports: binary\r\n", TX_NEVER_DROP);
+}
+
+// period <seconds>
+static void commandPeriod(int argc, char* argv[])
+{
+    unsigned int seconds = 0;
+
+    if (argc != 2 || !decimalParse(argv[1], &seconds) ||
+        seconds == 0 || seconds > REPORT_PERIOD_MAX_S) {
+        serialTxWriteLiteral("Usage: period <1-3600>\r\n", TX_NEVER_DROP);
+        return;
+    }
+    reportPeriodMs = seconds * 1000;
+    reportRestart();
+    reportSettingsSend();
+}
+
+// onchange [on|off], toggles without an argument
+static void commandOnChange(int argc, char* argv[])
+{
+    if (argc == 1) {
+        reportOnChange = !reportOnChange;
+    } else if (argc == 2 && strcmp(argv[1], "on") == 0) {
+        reportOnChange = true;
+    } else if (argc == 2 && strcmp(argv[1], "off") == 0) {
+        reportOnChange = false;
+    } else {
+        serialTxWriteLiteral("Usage: onchange [on|off]\r\n", TX_NEVER_DROP);
+        return;
+    }
+    reportRestart();
+    reportSettingsSend();
+}
+
+// Wake-ups and sleep statistics since the last query
+static void commandPower(int argc, char* argv[])
+{
+    lowPowerStatsSend();
+}
+
+static void commandBoot(int argc, char* argv[])
+{
+    bootSend();
+}
+
+// Also runs for unknown commands
+static void commandHelp(int argc, char* argv[])
+{
+    availableCommands();
+}
+
+static void commandLog(int argc, char* argv[])
+{
+    if (textJobClaim()) {
+        eventLogSendStart();
+        textJobPost(eventLogSendStep);
+    }
+}
+
+static void commandHistory(int argc, char* argv[])
+{
+    if (textJobClaim()) {
+        persistSendStart();
+        textJobPost(persistSendStep);
+    }
+}
+
+// Maintenance commands for a unit in the field. The alarm state belongs to
+// the alarm thread, so the threaded build posts the change there.
+// unlock <secret>, see ALARM_ADMIN_SECRET
+static void commandUnlock(int argc, char* argv[])
+{
+    if (!stateRestored) {
+        adminNotReady();
+        return;
+    }
+    if (argc != 2 || !adminSecretMatches(argv[1])) {
+        adminRefuse(ADMIN_UNLOCK);
+        return;
+    }
+    adminUnlockPost();
+}
+
+// code <secret> <buttons>, the code buttons held when Enter is pressed, e.g. "code <secret> ab"
+static void commandCode(int argc, char* argv[])
+{
+    inputMask_t code = 0;
+
+    if (argc != 3 || !codeParse(argv[2], &code)) {
+        serialTxWriteLiteral("Usage: code <secret> <1 to 3 of the buttons a, b, c, d>\r\n", TX_NEVER_DROP);
+        return;
+    }
+    if (!stateRestored) {
+        adminNotReady();
+        return;
+    }
+    if (!adminSecretMatches(argv[1])) {
+        adminRefuse(ADMIN_CODE);
+        return;
+    }
+#if ALARM_THREADED
+    eventQueue.call(adminCodeWrite, code);
+#else
+    adminCodeWrite(code);
+#endif
+}
+
+#if ALARM_PROFILE || ALARM_SUPERVISOR
+static void commandStats(int argc, char* argv[])
+{
+    profileSend();                  // Empty unless ALARM_PROFILE is set
+    supervisorSend();
+}
+#endif
+
+#if ALARM_THREADED
+static void commandThreads(int argc, char* argv[])
+{
+    threadsStackSend();
+}
+#endif
+
+#if ALARM_NETWORK
+static void commandNetwork(int argc, char* argv[])
+{
+    networkStatsSend();
+}
+#endif
+
+#if ANALOG_STREAM
+// stream [on|off|<decimation>], shows the stream state without an argument
+static void commandStream(int argc, char* argv[])
+{
+    unsigned int decimation = ANALOG_STREAM_DECIMATION;
+
+    if (argc == 2 && strcmp(argv[1], "off") == 0) {
+        streamStop();
+    } else if (argc == 2 && (strcmp(argv[1], "on") == 0 || decimalParse(argv[1], &decimation))) {
+        if (telemetryModeRead() != TELEMETRY_BINARY) {
+            serialTxWriteLiteral("Streaming needs binary mode\r\n", TX_NEVER_DROP);
+            return;
         }
+        if (!streamStart(decimation)) {
+            serialTxWriteLiteral("Decimation must be 1, 2, 4, 8, 16 or 32\r\n", TX_NEVER_DROP);
+            return;
+        }
+    } else if (argc != 1) {
+        serialTxWriteLiteral("Usage: stream [on|off|<decimation>]\r\n", TX_NEVER_DROP);
+        return;
+    }
+    streamStatusSend();
+}
+#endif
+
+// Queues "<message>\r\n", or "<message> (<n> suppressed)\r\n" after suppressed
+// onsets, or a TELEMETRY_PACKET_WARNING packet in binary mode
+static void warningSend(int sensor, uint32_t nowMs)
+{
+    reportWarning_t* warning = &sensorWarnings[sensor];
+    serialTxPolicy_t policy = (sensors[sensor].severity == SENSOR_SEVERITY_CRITICAL) ?
+                              TX_NEVER_DROP : TX_DROP_OLDEST;   // Stale warnings may be dropped
+
+    if (telemetryModeRead() == TELEMETRY_BINARY) {
+        telemetryWarningSend((uint8_t)sensor, warning->suppressed, policy);
     } else {
-        systemBlockedLed = ON;              // Indicate lockout (not relevant to Task 3)
+        char buffer[WARNING_MAX_LENGTH];
+        size_t length = reportWarningWrite(warning, sensors[sensor].warning, buffer);
+
+        serialTxWrite(buffer, length, policy);
     }
+    reportWarningSent(warning, nowMs);
 }
 
-// [Requirement (i)]: Handles user input to report sensor states via UART
-void uartTask()
+// Every warning with the longest suppressed count and line ending fits in WARNING_MAX_LENGTH
+static constexpr bool warningsFit()
 {
-    char receivedChar = '\0';  // Variable to store the incoming character from the PC
+    for (int sensor = 0; sensor < SENSOR_COUNT; sensor++) {
+        size_t length = 0;
+        while (sensors[sensor].warning[length] != '\0') {
+            length++;
+        }
+        if (length + literalLength(" (4294967295 suppressed)\r\n") > WARNING_MAX_LENGTH) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    if (uartUsb.readable()) {  // Check if there is data to read from the USB serial port
-        uartUsb.read(&receivedChar, 1);  // Read one character from the serial port
+static_assert(warningsFit(), "A sensor warning is too long for WARNING_MAX_LENGTH");
 
-        switch (receivedChar) {
-            case '1':  // Optional command for alarm state (not in requirements)
-                uartUsb.write(alarmState ? "The alarm is activated\r\n" : "The alarm is not activated\r\n",
-                              alarmState ? 24 : 28);
-                break;
-            case '2':  // [Requirement (i)]: Report gas detector state when '2' is pressed
-                uartUsb.write(gasDetector ? "Gas detected!\r\n" : "No gas detected\r\n",
-                              gasDetector ? 15 : 18);  // Send gas state to PC
-                break;
-            case '3':  // [Requirement (i)]: Report temperature detector state when '3' is pressed
-                uartUsb.write(overTempDetector ? "Over temperature detected!\r\n" : "Temperature normal\r\n",
-                              overTempDetector ? 28 : 20);  // Send temperature state to PC
-                break;
-            default:
-                availableCommands();  // Display available commands if invalid key is pressed
+// Records each debounced sensor edge at the time of the edge itself, so the
+// log shows which sensor fired first however long each one took to debounce
+static void inputChangesLog(inputMask_t changed)
+{
+    inputMask_t inputs = inputsRead();
+
+    for (inputMask_t m = changed & INPUT_SENSORS; m != 0; m &= m - 1) {
+        int sensor = inputLowest(m);
+        eventLogRecordAt((inputs & ((inputMask_t)1 << sensor)) ? EVENT_SENSOR_ON : EVENT_SENSOR_OFF,
+                         (uint8_t)sensor, inputsChangeUs(sensor));
+    }
+}
+
+// Alarm and code entry events also go to flash, with the state after the event
+static void stateEventRecord(eventType_t type, uint8_t value)
+{
+    persistState_t state;
+
+    state.alarmState = alarmSystem.alarmState;
+    state.incorrectCodes = (uint8_t)alarmSystem.numberOfIncorrectCodes;
+    state.code = (uint8_t)(alarmSystem.code >> INPUT_SENSOR_LIMIT);
+    eventLogRecord(type, value);
+    persistRecord(type, value, &state);
+    if (!schedulerJobRunning(persistJob)) {
+        schedulerJobStart(persistJob);
+    }
+}
+
+// Keeps running until the records have been flushed, by the report thread
+// in the threaded build
+static void persistFlushJob()
+{
+    reportThreadRun(persistFlush);
+    if (!persistPending()) {
+        schedulerJobStop(persistJob);
+    }
+}
+
+// Periodic report from the scheduler, which also measures how late it went out
+static void statusReportJob()
+{
+    profileSampleAdd(PROFILE_REPORT_SLIP,
+                     (uint32_t)std::chrono::microseconds(schedulerLateness()).count());
+    reportThreadRun(sendStatusReport);
+}
+
+#if ALARM_ANALOG
+// Level of every analog sensor, "Gas level: <mV> mV" lines in text mode or a
+// TELEMETRY_PACKET_ANALOG packet in binary mode
+static void analogLevelsSend()
+{
+    telemetryAnalog_t levels[TELEMETRY_MAX_ANALOG];
+    int count = 0;
+
+    for (inputMask_t m = INPUT_ANALOG_SENSORS; m != 0 && count < TELEMETRY_MAX_ANALOG; m &= m - 1) {
+        int sensor = inputLowest(m);
+        levels[count].sensor = (uint8_t)sensor;
+        levels[count].millivolts = (uint16_t)analogMillivoltsRead(sensor);
+        count++;
+    }
+
+    if (telemetryModeRead() == TELEMETRY_BINARY) {
+        telemetryAnalogSend(levels, count);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        char buffer[32];
+        size_t length = 0;
+
+        if (sensors[levels[i].sensor].type == SENSOR_GAS) {
+            length += literalAppend(&buffer[length], "Gas level: ");
+        } else {
+            length += literalAppend(&buffer[length], "Temperature level: ");
+        }
+        length += decimalWrite(&buffer[length], levels[i].millivolts);
+        length += literalAppend(&buffer[length], " mV\r\n");
+        serialTxWrite(buffer, length, TX_NEVER_DROP);
+    }
+}
+#endif
+
+// Ends the edge to LED measurement once the alarm LED has followed a debounced
+// sensor change, or drops it if the edge was a glitch that never got accepted
+static void edgeLatencyUpdate(inputMask_t changed)
+{
+    if (changed & INPUT_SENSORS) {
+        profileEdgeDone();
+    } else if (!(inputsPending() & INPUT_SENSORS)) {
+        profileEdgeCancel();
+    }
+}
+
+// Queues the next deferred boot stage behind the events already pending, so
+// an alarm raised during the boot is acted on between two stages
+static void bootStageNext(void (*stage)())
+{
+#if ALARM_EVENT_DRIVEN
+    schedulerArm();                 // The stage may have started jobs
+    eventQueue.call(stage);
+#else
+    bootPendingStage = stage;       // Run by the polling loop
+#endif
+}
+
+// The command line receives from here on and the periodic reports start
+static void bootConsoleStage()
+{
+#if ALARM_EVENT_DRIVEN
+#if ALARM_MODBUS
+    modbusInit(uartRxIsr, modbusRegisterRead, modbusRegisterWrite);  // Requests for this node wake the handler
+#else
+    serialRxInit(uartRxIsr);        // Received characters are queued by the RX interrupt
+#endif
+#if ALARM_LOW_POWER
+    schedulerJobStart(rxAwakeJob);
+    lowPowerInit(rxWakeIsr);        // RX pin wakes the board while the RX interrupt is released
+#endif
+#else
+#if ALARM_MODBUS
+    modbusInit(nullptr, modbusRegisterRead, modbusRegisterWrite);  // Requests wait for the next pass
+#else
+    serialRxInit(nullptr);          // Received characters wait in the RX ring for the next pass
+#endif
+#endif
+    reportRestart();                // [Requirement (ii), (iii)]: Start periodic status reporting
+    bootMark(BOOT_CONSOLE_READY);
+#if ALARM_THREADED
+    schedulerArm();
+    reportQueue.call(bootLogStage); // The flash scan never holds up the alarm thread
+#else
+    bootStageNext(bootLogStage);
+#endif
+}
+
+// Scans the flash log, which erases a sector after a reset in the middle of a
+// snapshot. Without threads the alarm events wait for it.
+static void bootLogStage()
+{
+    restoredStateValid = persistInit(&restoredState);
+#if ALARM_THREADED
+    eventQueue.call(bootRestoreStage);  // The alarm thread owns the alarm state
+#else
+    bootStageNext(bootRestoreStage);
+#endif
+}
+
+static void bootRestoreStage()
+{
+    stateRestore();                 // Lockout and alarm state survive a reset
+    stateRestored = true;           // Code entry from here on, with the saved code and attempts
+    if (persistPending() && !schedulerJobRunning(persistJob)) {
+        schedulerJobStart(persistJob);  // Finishes an erase left by a reset, then the boot record
+    }
+    bootMark(BOOT_LOG_READY);
+    bootStageNext(bootCompleteStage);
+}
+
+static void bootCompleteStage()
+{
+#if ANALOG_STREAM
+    streamInit();                   // Raw samples follow the ADC blocks once started
+#endif
+#if ALARM_NETWORK
+    networkInit();                  // Connects in the background, reports are published once it is up
+#endif
+    bootMark(BOOT_COMPLETE);
+    bootSend();
+    availableCommands();
+}
+
+// A power cycle must not clear the alarm or the lockout. An alarm raised
+// before the flash scan is kept, and only now reaches the flash log. No code
+// can have been entered yet, so the attempts and the code are the saved ones.
+static void stateRestore()
+{
+    bool alarmRaised = alarmSystem.alarmState;
+
+    if (!restoredStateValid) {
+        return;
+    }
+    alarmLogicInit(&alarmSystem, restoredState.alarmState || alarmRaised, restoredState.incorrectCodes,
+                   (inputMask_t)restoredState.code << INPUT_SENSOR_LIMIT);
+    alarmLogicHookAttach(&alarmSystem, alarmTransitionLog);  // Cleared by alarmLogicInit()
+    if (alarmRaised && !restoredState.alarmState) {
+        stateEventRecord(EVENT_ALARM, ON);
+    }
+    alarmChangeApply(0);            // A restored lockout starts its backoff again
+}
+
+// Logs the events of an alarm update and shows the new state on the LEDs
+static void alarmEventsApply(alarmLogicEvents_t events)
+{
+    alarmEventsRecord(events);
+    alarmLedsUpdate();
+    alarmStatePublish();
+    lockoutJobUpdate();
+}
+
+// The alarm LED blinks fast while a sensor is still active and stays on once
+// the alarm is only latched. The lockout LED blinks slowly during the backoff.
+// The leds module only writes a pin when its pattern changes.
+static void alarmLedsUpdate()
+{
+    ledPattern_t alarmPattern = LED_PATTERN_OFF;
+
+    if (alarmSystem.alarmState) {
+        alarmPattern = (inputsRead() & INPUT_SENSORS) ? LED_PATTERN_BLINK_FAST : LED_PATTERN_ON;
+    }
+    ledPatternWrite(LED_ALARM, alarmPattern);       // Reflect alarm state on LED (visual indicator)
+    ledPatternWrite(LED_INCORRECT_CODE,             // (not relevant to Task 3)
+                    alarmSystem.incorrectCode ? LED_PATTERN_ON : LED_PATTERN_OFF);
+    ledPatternWrite(LED_SYSTEM_BLOCKED,             // (not relevant to Task 3)
+                    alarmSystem.systemBlocked ? LED_PATTERN_BLINK_SLOW : LED_PATTERN_OFF);
+}
+
+// For the updates that do not come from an input change, which then also
+// need the reports and periodic jobs brought up to date
+static void alarmChangeApply(alarmLogicEvents_t events)
+{
+    alarmEventsApply(events);
+#if ALARM_EVENT_DRIVEN
+    statusChangeReport();
+    periodicEventsUpdate();
+#endif
+}
+
+// Runs after every alarm update. Only this writes the state word the commands
+// and reports read, and in the threaded build a change wakes the report thread.
+static void alarmStatePublish()
+{
+    bool changed = systemStatePublish(inputsRead() & INPUT_SENSORS, alarmSystem.alarmState,
+                                      alarmLogicLockout(&alarmSystem),
+                                      (uint8_t)alarmSystem.numberOfIncorrectCodes);
+
+#if ALARM_THREADED
+    if (changed && !reportEventPending) {
+        reportEventPending = true;
+        reportQueue.call(statusChangeHandler);
+    }
+#else
+    (void)changed;
+#endif
+}
+
+// Logs what an alarm logic update did, in the order it happened: a button
+// transition always comes before the sensor one in the same update
+static void alarmEventsRecord(alarmLogicEvents_t events)
+{
+    if (events & ALARM_LOGIC_DEACTIVATED) {
+        stateEventRecord(EVENT_CODE_ATTEMPT, 1);
+        stateEventRecord(EVENT_ALARM, OFF);
+    }
+    if (events & ALARM_LOGIC_CODE_INCORRECT) {
+        stateEventRecord(EVENT_CODE_ATTEMPT, 0);
+    }
+    if (events & ALARM_LOGIC_LOCKOUT) {
+        stateEventRecord(EVENT_LOCKOUT, (uint8_t)alarmSystem.numberOfIncorrectCodes);
+    }
+    if (events & ALARM_LOGIC_UNLOCKED) {
+        stateEventRecord(EVENT_LOCKOUT, 0);
+    }
+    if (events & ALARM_LOGIC_ACTIVATED) {
+        stateEventRecord(EVENT_ALARM, ON);
+    }
+}
+
+// The backoff is timed by the scheduler, so the system keeps sleeping, reporting
+// and answering commands while it is blocked
+static void lockoutJobUpdate()
+{
+    bool blocked = alarmLogicLockout(&alarmSystem);
+
+    if (blocked && !schedulerJobRunning(lockoutJob)) {
+        schedulerJobPeriodWrite(lockoutJob, alarmLogicLockoutMs(&alarmSystem));
+        schedulerJobStart(lockoutJob);
+    } else if (!blocked && schedulerJobRunning(lockoutJob)) {
+        schedulerJobStop(lockoutJob);
+    }
+}
+
+#if ALARM_SUPERVISOR
+// Runs on the alarm thread, so a stalled alarm loop never kicks the watchdog.
+// The other threads are asked to check in, and must have done so by the
+// next period. A flash sector erase holds the report thread for about a
+// second, which shows as a miss but is well inside the watchdog time.
+static void supervisorRun()
+{
+    supervisorDeadline(SUPERVISOR_ALARM,
+                       schedulerLateness() < std::chrono::milliseconds(SUPERVISOR_PERIOD_MS));
+    if (supervisorCheckInStart(SUPERVISOR_REPORT)) {
+        reportThreadRun(reportCheckIn);
+    }
+#if ALARM_THREADED
+    if (supervisorCheckInStart(SUPERVISOR_COMMAND)) {
+        commandQueue.call(commandCheckIn);
+    }
+#endif
+    supervisorKick();
+}
+
+static void reportCheckIn()
+{
+    supervisorCheckIn(SUPERVISOR_REPORT);
+}
+
+#if ALARM_THREADED
+static void commandCheckIn()
+{
+    supervisorCheckIn(SUPERVISOR_COMMAND);
+}
+#endif
+#endif
+
+static void lockoutExpireJob()
+{
+    alarmChangeApply(alarmLogicLockoutExpire(&alarmSystem));
+}
+
+// The unlock command and the Modbus unlock register run on the command thread
+static void adminUnlockPost()
+{
+#if ALARM_THREADED
+    eventQueue.call(adminUnlock);
+#else
+    adminUnlock();
+#endif
+}
+
+static void adminUnlock()
+{
+    alarmChangeApply(alarmLogicUnlock(&alarmSystem));
+    serialTxWriteLiteral("[ADMIN] Incorrect codes cleared\r\n", TX_NEVER_DROP);
+#if ALARM_THREADED
+    schedulerArm();
+#endif
+}
+
+// The new code goes to flash with the next record, the log only says it changed
+static void adminCodeWrite(inputMask_t code)
+{
+    alarmLogicCodeWrite(&alarmSystem, code);
+    stateEventRecord(EVENT_CODE_SET, 0);
+    serialTxWriteLiteral("[ADMIN] Deactivation code changed\r\n", TX_NEVER_DROP);
+#if ALARM_THREADED
+    schedulerArm();
+#endif
+}
+
+// Looks at every character of the secret whatever the text, so the time taken
+// does not show how much of it matched
+static bool adminSecretMatches(const char* text)
+{
+#ifdef ALARM_ADMIN_SECRET
+    static const char secret[] = ALARM_ADMIN_SECRET;
+    size_t length = strlen(text);
+    unsigned int difference = (length != sizeof(secret) - 1);
+
+    for (size_t i = 0; i < sizeof(secret) - 1; i++) {
+        difference |= (unsigned char)(i < length ? text[i] : '\0') ^ (unsigned char)secret[i];
+    }
+    return difference == 0 && sizeof(secret) > 1;
+#else
+    (void)text;
+    return false;                   // No secret configured, the commands stay disabled
+#endif
+}
+
+// Runs on the thread that received the command, the record is made by the
+// alarm thread like every other state record
+static void adminRefuse(adminAction_t action)
+{
+    serialTxWriteLiteral("[ADMIN] Refused, wrong or missing secret\r\n", TX_NEVER_DROP);
+#if ALARM_THREADED
+    eventQueue.call(adminRefusedRecord, action);
+#else
+    adminRefusedRecord(action);
+#endif
+}
+
+// Before the flash scan the secret is not even checked, so there is no
+// attempt to count and none that could be lost
+static void adminNotReady()
+{
+    serialTxWriteLiteral("[ADMIN] Not ready, the saved state is still loading\r\n", TX_NEVER_DROP);
+}
+
+static void adminRefusedRecord(adminAction_t action)
+{
+    stateEventRecord(EVENT_ADMIN_REFUSED, (uint8_t)action);
+#if ALARM_THREADED
+    schedulerArm();
+#endif
+}
+
+// Letters a to d in any order and case, each one a code button held
+static bool codeParse(const char* text, inputMask_t* code)
+{
+    *code = 0;
+    for (; *text != '\0'; text++) {
+        char c = (*text >= 'A' && *text <= 'D') ? (char)(*text - 'A' + 'a') : *text;
+        if (c < 'a' || c > 'd') {
+            return false;
+        }
+        *code |= (inputMask_t)INPUT_A_BUTTON << (c - 'a');
+    }
+    return alarmLogicCodeValid(*code);
+}
+
+#if ALARM_MODBUS
+// Reads only the published state word and counters, so it may run on any thread
+static uint8_t modbusRegisterRead(uint16_t address, uint16_t* value)
+{
+    systemState_t state = systemStateRead();
+    modbusCounters_t counters = modbusCountersRead();
+    const uint16_t registers[] = {          // In MODBUS_REG_* order from 0
+        (uint16_t)(statusBitsRead(&state) | (state.lockout ? STATUS_LOCKOUT_BIT : 0)),
+        (uint16_t)state.sensors,
+        state.incorrectCodes,
+        state.sequence,
+        (uint16_t)counters.requests,
+        (uint16_t)counters.crcErrors,
+        (uint16_t)counters.overruns,
+        (uint16_t)counters.exceptions,
+    };
+
+    if (address < sizeof(registers) / sizeof(registers[0])) {
+        *value = registers[address];
+        return MODBUS_OK;
+    }
+    if (address == MODBUS_REG_UNLOCK) {
+        *value = 0;
+        return MODBUS_OK;
+    }
+#if ALARM_ANALOG
+    if (address >= MODBUS_REG_ANALOG && address < MODBUS_REG_ANALOG + SENSOR_ANALOG_COUNT) {
+        int index = address - MODBUS_REG_ANALOG;
+        for (inputMask_t m = INPUT_ANALOG_SENSORS; m != 0; m &= m - 1) {
+            if (index-- == 0) {
+                *value = (uint16_t)analogMillivoltsRead(inputLowest(m));
                 break;
+            }
         }
+        return MODBUS_OK;
     }
+#endif
+    return MODBUS_ILLEGAL_DATA_ADDRESS;
 }
 
-// Prints list of available UART commands
-void availableCommands()
+// The unlock key guards against a stray write ending a lockout
+// A broadcast unlock would unlock every node on the bus at once, so the key
+// is only taken from a request addressed to this node
+static uint8_t modbusRegisterWrite(uint16_t address, uint16_t value, bool broadcast)
 {
-    uartUsb.write("Available commands:\r\n", 21);
-    uartUsb.write("Press '1' to get the alarm state\r\n", 33);
-    uartUsb.write("Press '2' to check gas status\r\n", 32);
-    uartUsb.write("Press '3' to check temperature status\r\n\r\n", 41);
+    uint16_t current = 0;
+
+    if (address != MODBUS_REG_UNLOCK) {
+        return modbusRegisterRead(address, &current) == MODBUS_OK ?
+               MODBUS_ILLEGAL_FUNCTION : MODBUS_ILLEGAL_DATA_ADDRESS;
+    }
+    if (broadcast) {
+        return MODBUS_ILLEGAL_FUNCTION;
+    }
+    if (!stateRestored) {
+        return MODBUS_SERVER_BUSY;
+    }
+    if (value != MODBUS_UNLOCK_KEY) {
+        adminRefuse(ADMIN_MODBUS_UNLOCK);
+        return MODBUS_ILLEGAL_DATA_VALUE;
+    }
+    adminUnlockPost();
+    return MODBUS_OK;
 }
+#endif
 
-// [Requirement (ii), (iii)]: Sends periodic and continuous status updates every 5 seconds
-void sendStatusReport()
+// inputsInit() takes the levels at power on as debounced, so a sensor that is
+// already active never shows up as a change. Both builds run this once before
+// their loop, which logs and acts on it like an edge.
+static void alarmPowerOnUpdate()
 {
-    char buffer[128];
-    int len = snprintf(buffer, sizeof(buffer),
-                       "\r\n[STATUS REPORT]\r\nAlarm: %s\r\nGas: %s\r\nTemperature: %s\r\n\r\n",
-                       alarmState ? "ON" : "OFF",          // Current alarm state
-                       gasDetector ? "Detected" : "Normal", // Gas detection status
-                       overTempDetector ? "High" : "Normal"); // Temperature status
-    uartUsb.write(buffer, len);  // Send the formatted report to the PC
+    inputChangesLog(inputsRead() & INPUT_SENSORS);
+    alarmUpdate(INPUT_SENSORS);
 }
 
-// [Requirement (iv)]: Continuously sends warning messages if dangerous conditions are detected
-void sendWarningIfNeeded()
+// Transition hook of the alarm state machine, only the state entered is logged
+static void alarmTransitionLog(alarmLogicState_t, alarmLogicState_t to, alarmLogicTrigger_t)
 {
-    if (gasDetector) {  // Check if gas detector indicates unsafe levels
-        uartUsb.write("[WARNING] Gas levels unsafe!\r\n", 29);  // Send warning to PC
+    eventLogRecord(EVENT_STATE, (uint8_t)to);
+}
+
+#if ALARM_EVENT_DRIVEN
+
+static void eventsInit()
+{
+    inputsSensorIrqAttach(sensorChangeIsr);     // Both edges of every sensor wake the handler
+
+    alarmPowerOnUpdate();                       // Act on a sensor that is already active at boot
+    statusChangeReport();
+    periodicEventsUpdate();
+
+    sensorEventPending = true;                  // Pick up an edge missed before the interrupts were attached
+    eventQueue.call(sensorChangeHandler);
+}
+
+// Runs in interrupt context: only posts the event, all work is done by the queue
+static void sensorChangeIsr()
+{
+    profileEdgeMark();
+    lowPowerWakeupCount();
+    if (!sensorEventPending) {
+        sensorEventPending = true;
+        eventQueue.call(sensorChangeHandler);
+    }
+}
+
+// Runs in interrupt context once the RX ring holds the received characters
+static void uartRxIsr()
+{
+    lowPowerWakeupCount();
+    if (!uartEventPending) {
+        uartEventPending = true;
+#if ALARM_THREADED
+        commandQueue.call(uartRxHandler);
+#else
+        eventQueue.call(uartRxHandler);
+#endif
+    }
+}
+
+static void sensorChangeHandler()
+{
+    uint32_t start = profileStart();
+
+    sensorEventPending = false;     // Cleared before the pins are read so no edge can be missed
+    inputsProcess();
+    schedulerArm();
+    profileStageEnd(PROFILE_PASS, start);
+}
+
+// Samples the inputs, keeps sampling them while one is being debounced and
+// acts on debounced sensor changes
+static void inputsProcess()
+{
+    inputMask_t changed = inputsUpdate();
+
+    if (inputsSettling() && !schedulerJobRunning(inputSampleJob)) {
+        schedulerJobStart(inputSampleJob);
+    } else if (!inputsSettling() && schedulerJobRunning(inputSampleJob)) {
+        schedulerJobStop(inputSampleJob);
     }
-    if (overTempDetector) {  // Check if temperature detector indicates unsafe levels
-        uartUsb.write("[WARNING] Temperature too high!\r\n", 33);  // Send warning to PC
+
+    if (changed != 0) {
+        inputChangesLog(changed);
+        alarmUpdate(changed);       // Update alarm state and LEDs as soon as the edge is confirmed
+        statusChangeReport();       // [Requirement (iv)]: Onset warning goes out with the edge
+        periodicEventsUpdate();
     }
-}
\ No newline at end of file
+    edgeLatencyUpdate(changed);
+}
+
+static void uartRxHandler()
+{
+    uint32_t start = profileStart();
+
+    uartEventPending = false;       // Cleared before the ring is read so no character can be missed
+    uartTask();                     // [Requirement (i)]: Run every complete command received
+#if ALARM_THREADED
+#if ALARM_LOW_POWER
+    eventQueue.call(rxWakeHandler); // The alarm thread owns the scheduler
+#endif
+#else
+#if ALARM_LOW_POWER
+    schedulerJobStart(rxAwakeJob);  // Keep the RX interrupt while the host is talking
+#endif
+    schedulerArm();                 // Commands may have changed the report period
+#endif
+    profileStageEnd(PROFILE_PASS, start);
+}
+
+static void codeEntryPoll()
+{
+    inputsProcess();                // The code entry buttons have no interrupts
+}
+
+// On-change report and onset warnings after an alarm or sensor update. The
+// threaded build sends them from the report thread as the state is published.
+static void statusChangeReport()
+{
+#if !ALARM_THREADED
+    reportOnChangeUpdate();
+    sendWarningIfNeeded();
+#endif
+}
+
+// Re-asserts the warnings while a sensor stays active
+static void warningRepeatJob()
+{
+    reportThreadRun(sendWarningIfNeeded);
+}
+
+// Keeps the warning repeat and code entry poll running only while they have work to do,
+// so an idle system only wakes for the status report and the supervisor, see alarm_config.h
+static void periodicEventsUpdate()
+{
+    bool sensorActive = inputsRead() & INPUT_SENSORS;
+    bool codeEntryNeeded = alarmLogicCodeEntryNeeded(&alarmSystem);
+
+    if (sensorActive && !schedulerJobRunning(warningJob)) {
+        schedulerJobStart(warningJob);
+    } else if (!sensorActive && schedulerJobRunning(warningJob)) {
+        schedulerJobStop(warningJob);
+    }
+
+    if (codeEntryNeeded && !schedulerJobRunning(codeEntryJob)) {
+        schedulerJobStart(codeEntryJob);
+    } else if (!codeEntryNeeded && schedulerJobRunning(codeEntryJob)) {
+        schedulerJobStop(codeEntryJob);
+    }
+}
+
+static void schedulerDispatch()
+{
+    uint32_t start = profileStart();
+
+    lowPowerWakeupCount();
+    schedulerEventId = 0;
+    schedulerRun();
+    schedulerArm();
+    profileStageEnd(PROFILE_PASS, start);
+}
+
+// Makes sure a single queued call is waiting for the earliest scheduler deadline.
+// Called at the end of every handler, as handlers may start, stop or restart jobs.
+static void schedulerArm()
+{
+    Kernel::Clock::time_point deadline = schedulerNextDeadline();
+
+    if (schedulerEventId != 0) {
+        if (deadline == schedulerArmedDeadline) {
+            return;
+        }
+        eventQueue.cancel(schedulerEventId);
+        schedulerEventId = 0;
+    }
+    if (deadline == Kernel::Clock::time_point::max()) {
+        return;                     // Nothing scheduled, sleep until the next interrupt
+    }
+
+    Kernel::Clock::duration delay = deadline - Kernel::Clock::now();
+    if (delay < Kernel::Clock::duration::zero()) {
+        delay = Kernel::Clock::duration::zero();
+    }
+    schedulerArmedDeadline = deadline;
+    schedulerEventId = eventQueue.call_in(std::chrono::milliseconds(delay), schedulerDispatch);
+}
+
+#if ALARM_LOW_POWER
+
+// The attached RX interrupt holds the deep sleep lock, so it is released when
+// the link has been quiet for RX_AWAKE_MS and the RX pin EXTI wake-up armed instead
+static void rxAwakeTimeout()
+{
+    schedulerJobStop(rxAwakeJob);
+    serialRxDetach();
+    lowPowerRxWakeArm();
+}
+
+// Runs in interrupt context on the start bit that woke the board
+static void rxWakeIsr()
+{
+    serialRxAttach();
+    eventQueue.call(rxWakeHandler);
+}
+
+static void rxWakeHandler()
+{
+    schedulerJobStart(rxAwakeJob);
+    schedulerArm();
+}
+
+#endif
+
+#if ALARM_THREADED
+
+static void statusChangeHandler()
+{
+    reportEventPending = false;     // Cleared before the state is read so no change can be missed
+    reportOnChangeUpdate();
+    sendWarningIfNeeded();          // [Requirement (iv)]: Onset warning goes out with the edge
+}
+
+#endif
+
+#else
+
+static void pollingLoopPass()
+{
+    uint32_t start = profileStart();
+    inputMask_t changed = inputsUpdate();  // Sample and debounce all inputs once for this pass
+
+    if (inputsPending() & INPUT_SENSORS) {
+        profileEdgeMark();          // No interrupts here, the edge is first seen by this pass
+    }
+    inputChangesLog(changed);
+    alarmUpdate(changed);           // Update alarm state (affects reporting), code entry included
+    edgeLatencyUpdate(changed);
+    uartTask();                     // [Requirement (i)]: Process UART input for sensor state requests
+    reportOnChangeUpdate();         // Report straight away if the status changed and on-change is set
+    sendWarningIfNeeded();          // [Requirement (iv)]: Continuously check and send rate limited warnings
+    profileStageEnd(PROFILE_PASS, start);
+}
+
+#endif
@@ -0,0 +1,282 @@
+//=====[Libraries]=============================================================
+
+#include "mbed.h"
+#include "arm_book_lib.h"
+
+#include "alarm_config.h"
+#include "modbus.h"
+#include "crc.h"
+
+#if ALARM_MODBUS
+
+//=====[Declaration of private defines]========================================
+
+// USART3 RX is DMA1 stream 1 and TX is DMA1 stream 3, both on channel 4
+#define MODBUS_DMA_CHANNEL      4
+#define MODBUS_RX_BUFFER_SIZE   256     // Circular, must be a power of two
+#define MODBUS_FRAME_MAX        256     // Longest RTU frame, address to CRC
+#define MODBUS_FRAME_MIN        4       // Address, function and CRC
+
+#define MODBUS_BROADCAST        0
+#define MODBUS_READ_HOLDING     0x03
+#define MODBUS_READ_INPUT       0x04
+#define MODBUS_WRITE_SINGLE     0x06
+#define MODBUS_READ_MAX         125     // Registers per read, so the response fits a frame
+#define MODBUS_EXCEPTION_FLAG   0x80
+
+#define MODBUS_RX_ERRORS        (USART_SR_PE | USART_SR_FE | USART_SR_NE | USART_SR_ORE)
+
+//=====[Declaration of external public global objects]=========================
+
+extern UnbufferedSerial uartUsb;
+
+//=====[Declaration and initialization of private global variables]============
+
+static DigitalOut driverEnable(MODBUS_DE_PIN, OFF);
+
+static modbusNotify_t requestNotify = nullptr;
+static modbusRegisterRead_t readRegister = nullptr;
+static modbusRegisterWrite_t writeRegister = nullptr;
+
+// The RX DMA writes round this buffer for ever. Each idle line marks the end
+// of a frame, which starts where the previous one ended.
+static uint8_t rxBuffer[MODBUS_RX_BUFFER_SIZE];
+static uint16_t rxFrameStart = 0;
+
+// Frames for other nodes are skipped in the interrupt, so only a request for
+// this node is copied out. It stays here until modbusProcess() has answered.
+static uint8_t request[MODBUS_FRAME_MAX];
+static volatile size_t requestLength = 0;  // 0 while no request is waiting
+static bool requestCorrupt = false;
+
+static uint8_t response[MODBUS_FRAME_MAX];
+static volatile bool responseSending = false;
+
+static modbusCounters_t counters;
+
+//=====[Declarations (prototypes) of private functions]========================
+
+static void modbusUsartIsr();
+static void rxFrameEnd(bool corrupt);
+static size_t requestAnswer(const uint8_t* frame, size_t length, bool broadcast);
+static size_t readAnswer(const uint8_t* frame, size_t length);
+static size_t writeAnswer(const uint8_t* frame, size_t length, bool broadcast);
+static size_t exceptionAnswer(uint8_t function, uint8_t code);
+static void responseSend(size_t length);
+static uint16_t wordRead(const uint8_t* data);
+static void wordWrite(uint8_t* data, uint16_t word);
+
+//=====[Implementations of public functions]===================================
+
+// Takes USART3 over from the serial driver. notify, if given, runs in
+// interrupt context when a request for this node is waiting.
+void modbusInit(modbusNotify_t notify, modbusRegisterRead_t registerRead,
+                modbusRegisterWrite_t registerWrite)
+{
+    requestNotify = notify;
+    readRegister = registerRead;
+    writeRegister = registerWrite;
+
+    uartUsb.format(8, SerialBase::Even, 1);    // RTU default framing, 8E1
+
+    RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN;
+    DMA1_Stream1->CR = 0;
+    DMA1->LIFCR = DMA_LIFCR_CTCIF1 | DMA_LIFCR_CHTIF1 | DMA_LIFCR_CTEIF1 |
+                  DMA_LIFCR_CDMEIF1 | DMA_LIFCR_CFEIF1;
+    DMA1_Stream1->PAR = (uint32_t)&USART3->DR;
+    DMA1_Stream1->M0AR = (uint32_t)rxBuffer;
+    DMA1_Stream1->NDTR = MODBUS_RX_BUFFER_SIZE;
+    DMA1_Stream1->CR = ((uint32_t)MODBUS_DMA_CHANNEL << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_PL_1 |
+                       DMA_SxCR_MINC | DMA_SxCR_CIRC | DMA_SxCR_EN;
+    DMA1_Stream3->CR = 0;
+    DMA1_Stream3->PAR = (uint32_t)&USART3->DR;
+
+    NVIC_SetVector(USART3_IRQn, (uint32_t)modbusUsartIsr);
+    USART3->CR3 |= USART_CR3_DMAR | USART_CR3_DMAT;
+    USART3->CR1 |= USART_CR1_IDLEIE;
+    NVIC_EnableIRQ(USART3_IRQn);
+}
+
+// Answers the waiting request, if any. Broadcasts are carried out but never
+// answered, as every node on the bus receives them.
+void modbusProcess()
+{
+    size_t length = requestLength;
+
+    if (length == 0 || responseSending) {
+        return;                         // The end of the response notifies again
+    }
+
+    if (requestCorrupt || crc16Modbus(request, length - 2) != (request[length - 2] | (request[length - 1] << 8))) {
+        counters.crcErrors++;
+    } else {
+        bool broadcast = request[0] == MODBUS_BROADCAST;
+        size_t responseLength = requestAnswer(request, length - 2, broadcast);
+        if (!broadcast) {
+            responseSend(responseLength);
+        }
+    }
+    requestLength = 0;                  // A new request may now be copied in
+}
+
+modbusCounters_t modbusCountersRead()
+{
+    return counters;
+}
+
+//=====[Implementations of private functions]==================================
+
+// Runs in interrupt context. Reading SR and then DR clears the idle flag and,
+// with it, any error flag the last frame raised.
+static void modbusUsartIsr()
+{
+    uint32_t status = USART3->SR;
+
+    if (status & USART_SR_IDLE) {
+        (void)USART3->DR;
+        rxFrameEnd((status & MODBUS_RX_ERRORS) != 0);
+    }
+    if ((USART3->CR1 & USART_CR1_TCIE) && (status & USART_SR_TC)) {
+        USART3->CR1 &= ~USART_CR1_TCIE;     // Last stop bit is out, release the bus
+        driverEnable = OFF;
+        DMA1_Stream3->CR = 0;
+        responseSending = false;
+        if (requestLength != 0 && requestNotify != nullptr) {
+            requestNotify();
+        }
+    }
+}
+
+// Runs in interrupt context at the idle line after a frame. The idle line
+// comes one character time after the last byte, sooner than the 3.5 character
+// gap RTU defines, which every master leaves between frames anyway.
+static void rxFrameEnd(bool corrupt)
+{
+    uint16_t end = (uint16_t)(MODBUS_RX_BUFFER_SIZE - DMA1_Stream1->NDTR) & (MODBUS_RX_BUFFER_SIZE - 1);
+    size_t length = (uint16_t)(end - rxFrameStart) & (MODBUS_RX_BUFFER_SIZE - 1);
+    uint8_t address = rxBuffer[rxFrameStart];
+    uint16_t start = rxFrameStart;
+
+    rxFrameStart = end;
+    if (length < MODBUS_FRAME_MIN || (address != MODBUS_ADDRESS && address != MODBUS_BROADCAST)) {
+        return;
+    }
+    counters.requests++;
+    if (requestLength != 0) {
+        counters.overruns++;
+        return;
+    }
+    for (size_t i = 0; i < length; i++) {
+        request[i] = rxBuffer[(start + i) & (MODBUS_RX_BUFFER_SIZE - 1)];
+    }
+    requestCorrupt = corrupt;
+    requestLength = length;
+    if (requestNotify != nullptr) {
+        requestNotify();
+    }
+}
+
+// frame is the request without its CRC. Returns the response length, also
+// without the CRC.
+static size_t requestAnswer(const uint8_t* frame, size_t length, bool broadcast)
+{
+    uint8_t function = frame[1];
+
+    switch (function) {
+    case MODBUS_READ_HOLDING:
+    case MODBUS_READ_INPUT:
+        return broadcast ? 0 : readAnswer(frame, length);
+    case MODBUS_WRITE_SINGLE:
+        return writeAnswer(frame, length, broadcast);
+    default:
+        return exceptionAnswer(function, MODBUS_ILLEGAL_FUNCTION);
+    }
+}
+
+// Holding and input registers share one map:
+// request  address, function, first register, count
+// response address, function, byte count, registers
+static size_t readAnswer(const uint8_t* frame, size_t length)
+{
+    if (length != 6) {
+        return exceptionAnswer(frame[1], MODBUS_ILLEGAL_DATA_VALUE);
+    }
+    uint16_t first = wordRead(&frame[2]);
+    uint16_t count = wordRead(&frame[4]);
+
+    if (count == 0 || count > MODBUS_READ_MAX) {
+        return exceptionAnswer(frame[1], MODBUS_ILLEGAL_DATA_VALUE);
+    }
+    for (uint16_t i = 0; i < count; i++) {
+        uint16_t value = 0;
+        uint8_t exception = readRegister((uint16_t)(first + i), &value);
+        if (exception != MODBUS_OK) {
+            return exceptionAnswer(frame[1], exception);
+        }
+        wordWrite(&response[3 + 2 * i], value);
+    }
+    response[0] = MODBUS_ADDRESS;
+    response[1] = frame[1];
+    response[2] = (uint8_t)(2 * count);
+    return 3 + 2 * count;
+}
+
+// request and response address, function, register, value
+static size_t writeAnswer(const uint8_t* frame, size_t length, bool broadcast)
+{
+    if (length != 6) {
+        return exceptionAnswer(frame[1], MODBUS_ILLEGAL_DATA_VALUE);
+    }
+    uint8_t exception = writeRegister(wordRead(&frame[2]), wordRead(&frame[4]), broadcast);
+
+    if (exception != MODBUS_OK) {
+        return exceptionAnswer(frame[1], exception);
+    }
+    memcpy(response, frame, 6);
+    response[0] = MODBUS_ADDRESS;
+    return 6;
+}
+
+static size_t exceptionAnswer(uint8_t function, uint8_t code)
+{
+    counters.exceptions++;
+    response[0] = MODBUS_ADDRESS;
+    response[1] = function | MODBUS_EXCEPTION_FLAG;
+    response[2] = code;
+    return 3;
+}
+
+// Drives the bus for the whole frame: the DMA fills the UART and the
+// transmission complete interrupt releases the driver after the last bit
+static void responseSend(size_t length)
+{
+    uint16_t crc = crc16Modbus(response, length);
+
+    response[length++] = (uint8_t)crc;
+    response[length++] = (uint8_t)(crc >> 8);
+
+    responseSending = true;
+    driverEnable = ON;
+    DMA1->LIFCR = DMA_LIFCR_CTCIF3 | DMA_LIFCR_CHTIF3 | DMA_LIFCR_CTEIF3 |
+                  DMA_LIFCR_CDMEIF3 | DMA_LIFCR_CFEIF3;
+    DMA1_Stream3->M0AR = (uint32_t)response;
+    DMA1_Stream3->NDTR = length;
+    USART3->SR = ~USART_SR_TC;          // TC is set again only after the last byte
+    USART3->CR1 |= USART_CR1_TCIE;
+    DMA1_Stream3->CR = ((uint32_t)MODBUS_DMA_CHANNEL << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_MINC |
+                       DMA_SxCR_DIR_0 | DMA_SxCR_EN;
+}
+
+// Modbus sends every 16 bit field high byte first, only the CRC low byte first
+static uint16_t wordRead(const uint8_t* data)
+{
+    return (uint16_t)((data[0] << 8) | data[1]);
+}
+
+static void wordWrite(uint8_t* data, uint16_t word)
+{
+    data[0] = (uint8_t)(word >> 8);
+    data[1] = (uint8_t)word;
+}
+
+#endif
@@ -0,0 +1,45 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _MODBUS_H_
+#define _MODBUS_H_
+
+//=====[Libraries]=============================================================
+
+#include <stdint.h>
+
+//=====[Declaration of public defines]=========================================
+
+// Exception codes returned by a register access
+#define MODBUS_OK                       0
+#define MODBUS_ILLEGAL_FUNCTION         1
+#define MODBUS_ILLEGAL_DATA_ADDRESS     2
+#define MODBUS_ILLEGAL_DATA_VALUE       3
+#define MODBUS_SERVER_BUSY              6   // Try again later
+
+//=====[Declaration of public data types]======================================
+
+typedef void (*modbusNotify_t)();
+
+// The register map belongs to the application. Each returns MODBUS_OK or an
+// exception code, and runs from modbusProcess(). broadcast is set for a write
+// sent to every node, which gets no response.
+typedef uint8_t (*modbusRegisterRead_t)(uint16_t address, uint16_t* value);
+typedef uint8_t (*modbusRegisterWrite_t)(uint16_t address, uint16_t value, bool broadcast);
+
+typedef struct {
+    unsigned int requests;      // Frames addressed to this node, broadcasts included
+    unsigned int crcErrors;     // Frames for this node dropped for their CRC, parity or framing
+    unsigned int overruns;      // Frames for this node dropped while one was still waiting
+    unsigned int exceptions;    // Exception responses sent
+} modbusCounters_t;
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+void modbusInit(modbusNotify_t notify, modbusRegisterRead_t registerRead,
+                modbusRegisterWrite_t registerWrite);
+void modbusProcess();
+modbusCounters_t modbusCountersRead();
+
+//=====[#include guards - end]=================================================
+
+#endif // _MODBUS_H_
@@ -0,0 +1,230 @@
+//=====[Libraries]=============================================================
+
+#include "mbed.h"
+#include "arm_book_lib.h"
+
+#include "alarm_config.h"
+#include "network.h"
+
+#if ALARM_NETWORK
+
+#include "EthernetInterface.h"
+
+#include "serial_tx.h"
+#include "text_format.h"
+
+//=====[Declaration of private defines]========================================
+
+// Below every other thread: a DHCP lease or a slow host must never hold up
+// an alarm update, a command or a serial report
+#define NETWORK_THREAD_PRIORITY osPriorityLow
+#define NETWORK_THREAD_STACK    4096
+
+#define NETWORK_QUEUE_SIZE      16      // Changes waiting for the thread, must be a power of two
+#define NETWORK_DATAGRAM_MAX    1024    // Queued publishes are packed into datagrams up to this size
+#define NETWORK_FLAG_PUBLISH    0x1
+#define NETWORK_LINE_LENGTH     96
+
+//=====[Declaration of private data types]=====================================
+
+typedef struct {
+    const char* data;
+    size_t length;
+} networkPublish_t;
+
+//=====[Declaration and initialization of private global objects]==============
+
+static Thread networkThread(NETWORK_THREAD_PRIORITY, NETWORK_THREAD_STACK, nullptr, "network");
+static EventFlags networkFlags;
+static EthernetInterface ethernet;
+static UDPSocket socket;
+static SocketAddress destination;
+
+//=====[Declaration and initialization of private global variables]============
+
+// Only the pointer is queued: publishers hand over data that stays valid, such
+// as the constant report frames, so nothing is copied on their threads.
+// head and tail run freely and are masked on access. A full queue loses its
+// oldest change, the newest one holds the current state.
+static networkPublish_t publishQueue[NETWORK_QUEUE_SIZE];
+static volatile uint16_t queueHead = 0;
+static volatile uint16_t queueTail = 0;
+
+// A heartbeat replaces the one still waiting, and a change cancels it, so
+// after an outage at most the latest goes out, after the queued changes
+static networkPublish_t heartbeat;
+static volatile bool heartbeatPending = false;
+static volatile unsigned int heartbeatSequence = 0;
+
+static char datagram[NETWORK_DATAGRAM_MAX];
+
+static volatile bool connected = false;
+static unsigned int datagramsSent = 0;
+static unsigned int publishesDropped = 0;
+static unsigned int connects = 0;
+
+//=====[Declarations (prototypes) of private functions]========================
+
+static void networkRun();
+static bool networkConnect();
+static void networkDisconnect();
+static size_t datagramFill();
+
+//=====[Implementations of public functions]===================================
+
+void networkInit()
+{
+    networkThread.start(networkRun);
+}
+
+// Queues data for the network thread and returns at once. data must stay
+// unchanged for good, the report frames do. Returns false when the oldest
+// queued change had to be dropped for it, which happens while the link is down.
+bool networkPublish(const char* data, size_t length, networkPublishType_t type)
+{
+    bool dropped = false;
+
+    core_util_critical_section_enter();
+    if (type == NETWORK_HEARTBEAT) {
+        heartbeat = { data, length };
+        heartbeatPending = true;
+        heartbeatSequence = heartbeatSequence + 1;
+    } else {
+        if ((uint16_t)(queueTail - queueHead) == NETWORK_QUEUE_SIZE) {
+            queueHead = queueHead + 1;
+            publishesDropped++;
+            dropped = true;
+        }
+        publishQueue[queueTail & (NETWORK_QUEUE_SIZE - 1)] = { data, length };
+        queueTail = queueTail + 1;
+        heartbeatPending = false;       // An older status must not follow the change
+    }
+    core_util_critical_section_exit();
+
+    networkFlags.set(NETWORK_FLAG_PUBLISH);
+    return !dropped;
+}
+
+// "[NETWORK] <up|down>, <n> datagrams, <n> dropped, <n> connects"
+void networkStatsSend()
+{
+    char line[NETWORK_LINE_LENGTH];
+    size_t length = 0;
+
+    length += literalAppend(&line[length], "[NETWORK] ");
+    length += connected ? literalAppend(&line[length], "up, ") : literalAppend(&line[length], "down, ");
+    length += decimalWrite(&line[length], datagramsSent);
+    length += literalAppend(&line[length], " datagrams, ");
+    length += decimalWrite(&line[length], publishesDropped);
+    length += literalAppend(&line[length], " dropped, ");
+    length += decimalWrite(&line[length], connects);
+    length += literalAppend(&line[length], " connects\r\n");
+    serialTxWrite(line, length, TX_NEVER_DROP);
+}
+
+//=====[Implementations of private functions]==================================
+
+// Network thread: (re)connects with a doubling backoff, then sends whatever
+// is queued each time it is woken, packed into as few datagrams as fit
+static void networkRun()
+{
+    uint32_t retryMs = NETWORK_RETRY_MIN_MS;
+
+    while (true) {
+        if (!connected) {
+            if (!networkConnect()) {
+                ThisThread::sleep_for(std::chrono::milliseconds(retryMs));
+                retryMs = (retryMs * 2 > NETWORK_RETRY_MAX_MS) ? NETWORK_RETRY_MAX_MS : retryMs * 2;
+                continue;
+            }
+            retryMs = NETWORK_RETRY_MIN_MS;
+        }
+
+        if (queueHead == queueTail && !heartbeatPending) {
+            networkFlags.wait_any(NETWORK_FLAG_PUBLISH);
+        }
+        size_t length = datagramFill();
+        if (length > 0 && socket.sendto(destination, datagram, length) < 0) {
+            networkDisconnect();        // The publishes in this datagram are lost
+        } else if (length > 0) {
+            datagramsSent++;
+        }
+    }
+}
+
+static bool networkConnect()
+{
+    if (ethernet.connect() != NSAPI_ERROR_OK) {
+        return false;
+    }
+    if (socket.open(&ethernet) != NSAPI_ERROR_OK) {
+        ethernet.disconnect();
+        return false;
+    }
+    if (ethernet.gethostbyname(NETWORK_HOST, &destination) != NSAPI_ERROR_OK) {
+        networkDisconnect();
+        return false;
+    }
+    destination.set_port(NETWORK_PORT);
+    connected = true;
+    connects++;
+    return true;
+}
+
+static void networkDisconnect()
+{
+    socket.close();
+    ethernet.disconnect();
+    connected = false;
+}
+
+// The socket needs one contiguous buffer, so this is the one copy a publish
+// goes through. The changes go first, oldest first, then the heartbeat. A
+// publish that does not fit waits for the next datagram. Publishers may drop
+// or replace an entry meanwhile, so one is only taken off if still in place.
+static size_t datagramFill()
+{
+    size_t length = 0;
+
+    while (true) {
+        networkPublish_t publish;
+        uint16_t index = 0;
+        unsigned int sequence = 0;
+        bool change = false;
+        bool available = true;
+
+        core_util_critical_section_enter();
+        if (queueHead != queueTail) {
+            index = queueHead;
+            publish = publishQueue[index & (NETWORK_QUEUE_SIZE - 1)];
+            change = true;
+        } else if (heartbeatPending) {
+            sequence = heartbeatSequence;
+            publish = heartbeat;
+        } else {
+            available = false;
+        }
+        core_util_critical_section_exit();
+
+        if (!available) {
+            break;
+        }
+        size_t publishLength = publish.length > NETWORK_DATAGRAM_MAX ? NETWORK_DATAGRAM_MAX : publish.length;
+        if (length + publishLength > NETWORK_DATAGRAM_MAX) {
+            break;
+        }
+        memcpy(&datagram[length], publish.data, publishLength);
+        length += publishLength;
+
+        core_util_critical_section_enter();
+        if (change && queueHead == index) {
+            queueHead = index + 1;
+        } else if (!change && heartbeatSequence == sequence) {
+            heartbeatPending = false;
+        }
+        core_util_critical_section_exit();
+    }
+    return length;
+}
+
+#endif
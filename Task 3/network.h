@@ -0,0 +1,25 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _NETWORK_H_
+#define _NETWORK_H_
+
+//=====[Libraries]=============================================================
+
+#include <stddef.h>
+
+//=====[Declaration of public data types]======================================
+
+typedef enum {
+    NETWORK_CHANGE,             // State change, every one is queued and sent first
+    NETWORK_HEARTBEAT,          // Periodic report, only the latest one is kept
+} networkPublishType_t;
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+void networkInit();
+bool networkPublish(const char* data, size_t length, networkPublishType_t type);
+void networkStatsSend();
+
+//=====[#include guards - end]=================================================
+
+#endif // _NETWORK_H_
@@ -0,0 +1,463 @@
+//=====[Libraries]=============================================================
+
+#include "mbed.h"
+#include "arm_book_lib.h"
+#include "FlashIAPBlockDevice.h"
+
+#include "alarm_config.h"
+#include "persist.h"
+#include "crc.h"
+#include "serial_tx.h"
+#include "text_format.h"
+
+//=====[Declaration of private defines]========================================
+
+// The last two 128 KB sectors of bank 2 (sectors 22 and 23) are reserved for
+// the log. Records are appended to the active sector; when it is full, the
+// last record is copied to the other, already erased, sector as a snapshot
+// and only then is the full sector erased, so the state is in flash throughout.
+#define PERSIST_BASE_ADDRESS    0x081C0000
+#define PERSIST_SECTOR_SIZE     (128 * 1024)
+#define PERSIST_SECTORS         2
+#define PERSIST_FIRST_SNB       0x1A    // FLASH_CR SNB of sector 22, bank 2 sectors start at 0x10
+#define PERSIST_FLASH_ERRORS    (FLASH_SR_SOP | FLASH_SR_WRPERR | FLASH_SR_PGAERR | \
+                                 FLASH_SR_PGPERR | FLASH_SR_PGSERR)
+#define PERSIST_RECORDS         (PERSIST_SECTOR_SIZE / sizeof(persistRecord_t))
+
+#define PERSIST_MARKER          0xA5
+#define PERSIST_FLAG_SNAPSHOT   0x01    // Copy of the last record, made on a sector change
+#define PERSIST_STATUS_ALARM    0x01    // Alarm on after the event
+#define PERSIST_STATUS_CODE_SHIFT   4   // Deactivation code in the high nibble, 0 in older records
+#define PERSIST_BUFFER_SIZE     16      // Records batched in RAM between flushes
+#define PERSIST_HISTORY_LINES   32      // Most recent records sent by persistSendStart()
+
+// Widest history line, every field at its widest: 5 digits of boot, 10 of
+// ms, 3 of value and of codes, plus the terminator. The header line is shorter.
+#define PERSIST_LINE_LENGTH     (literalLength("[HISTORY] boot ") + 5 + 1 + 10 + literalLength(" ms") + \
+                                 EVENT_NAME_MAX_LENGTH + 3 + literalLength(" codes ") + 3 + \
+                                 literalLength(" alarm ") + 1 + literalLength("\r\n") + 1)
+
+//=====[Declaration of private data types]=====================================
+
+typedef struct {
+    uint8_t marker;             // PERSIST_MARKER, erased flash reads 0xFF
+    uint8_t type;               // eventType_t
+    uint8_t value;
+    uint8_t incorrectCodes;     // State after the event
+    uint8_t status;             // PERSIST_STATUS_ALARM and the deactivation code
+    uint8_t flags;              // PERSIST_FLAG_*
+    uint16_t generation;        // Of the sector holding the record, the newer sector wins
+    uint32_t timestamp;         // ms since the boot that wrote the record
+    uint16_t boot;              // Number of boots since the log was created
+    uint16_t crc;               // crc16Ccitt of all the bytes before it
+} persistRecord_t;
+
+static_assert(sizeof(persistRecord_t) == 16, "persistRecord_t must stay packed");
+static_assert(PERSIST_LINE_LENGTH >= literalLength("[HISTORY] 8192 records, generation 65535, dropped 4294967295\r\n") + 1,
+              "The history header does not fit PERSIST_LINE_LENGTH");
+
+//=====[Declaration and initialization of private global variables]============
+
+static FlashIAPBlockDevice flash(PERSIST_BASE_ADDRESS, PERSIST_SECTOR_SIZE * PERSIST_SECTORS);
+static bool flashReady = false;
+
+static int activeSector = 0;
+static uint16_t activeGeneration = 0;
+static uint32_t activeTail = 0;         // Index of the first blank record in the active sector
+static persistRecord_t lastRecord;
+static uint16_t bootNumber = 0;
+
+// Filled by persistRecord() and emptied by persistFlush() in short critical
+// sections, so the alarm thread never waits for the flash
+static persistRecord_t pendingRecords[PERSIST_BUFFER_SIZE];
+static int pendingCount = 0;
+static unsigned int droppedRecords = 0; // Oldest pending records dropped while an erase ran
+
+// Sectors still to be erased, one bit each. The erase is started and then
+// polled by persistFlush(), nothing is programmed until they are all blank.
+static unsigned int erasePending = 0;
+static int eraseRunning = -1;           // Sector being erased, -1 when none
+
+// Copied out of flash by persistSendStart() and sent by persistSendStep()
+// once the flash lock is free
+static persistRecord_t historyRecords[PERSIST_HISTORY_LINES];
+static int historyCount = 0;
+static int historyNext = 0;
+
+#if ALARM_THREADED
+static Mutex flashMutex;                // Flushes run on the report and command threads
+#endif
+
+//=====[Declarations (prototypes) of private functions]========================
+
+static bool recordRead(int sector, uint32_t index, persistRecord_t* record);
+static bool recordBlank(int sector, uint32_t index);
+static bool recordProgram(persistRecord_t* record);
+static bool recordUrgent(eventType_t type);
+static uint32_t tailFind(int sector);
+static void sectorErase(int sector);
+static void eraseStep();
+static void sectorSwitch();
+static void pendingAdd(const persistRecord_t* record);
+static bool pendingProgram();
+static void flashLock();
+static void flashUnlock();
+
+//=====[Implementations of public functions]===================================
+
+// Finds the active sector and its tail, then restores the state from the last
+// record. Records are only ever appended, so the written part of a sector is
+// followed by blank flash and the tail is found by a binary search: about 13
+// reads, however full the sector is.
+bool persistInit(persistState_t* state)
+{
+    persistRecord_t header[PERSIST_SECTORS];
+    bool headerValid[PERSIST_SECTORS];
+
+    state->alarmState = false;
+    state->incorrectCodes = 0;
+    state->code = 0;
+    if (flash.init() != 0) {
+        return false;
+    }
+
+    for (int sector = 0; sector < PERSIST_SECTORS; sector++) {
+        headerValid[sector] = recordRead(sector, 0, &header[sector]);
+    }
+    if (headerValid[0] && headerValid[1]) {
+        // Reset between writing a snapshot and erasing the full sector. The
+        // erases run in the background, the records wait for them in RAM.
+        activeSector = (int16_t)(header[1].generation - header[0].generation) > 0 ? 1 : 0;
+        sectorErase(1 - activeSector);
+    } else if (headerValid[0] || headerValid[1]) {
+        activeSector = headerValid[1] ? 1 : 0;
+        if (!recordBlank(1 - activeSector, 0)) {
+            sectorErase(1 - activeSector);  // Reset during a snapshot or an erase
+        }
+    } else {
+        for (int sector = 0; sector < PERSIST_SECTORS; sector++) {
+            if (!recordBlank(sector, 0)) {
+                sectorErase(sector);
+            }
+        }
+        activeSector = 0;
+    }
+    activeGeneration = headerValid[activeSector] ? header[activeSector].generation : 0;
+    activeTail = (erasePending & (1u << activeSector)) ? 0 : tailFind(activeSector);
+
+    // A reset while programming leaves a torn last record, which fails its CRC
+    for (uint32_t index = activeTail; index > 0; index--) {
+        if (recordRead(activeSector, index - 1, &lastRecord)) {
+            state->alarmState = lastRecord.status & PERSIST_STATUS_ALARM;
+            state->incorrectCodes = lastRecord.incorrectCodes;
+            state->code = lastRecord.status >> PERSIST_STATUS_CODE_SHIFT;
+            bootNumber = lastRecord.boot + 1;
+            break;
+        }
+    }
+
+    flashReady = true;
+    persistRecord(EVENT_BOOT, 0, state);
+    persistFlush();
+    return true;
+}
+
+// Code attempts, lockouts, code changes, alarms and refused admin commands
+// are programmed at once,
+// after the records queued before them, so cutting the power straight after
+// one cannot undo it. Programming a record takes tens of microseconds. The
+// rest are only queued in RAM for persistFlush(), which the application runs
+// shortly afterwards from its scheduler. While a sector erase runs every
+// record waits in RAM.
+void persistRecord(eventType_t type, uint8_t value, const persistState_t* state)
+{
+    if (!flashReady) {
+        return;
+    }
+    persistRecord_t record;
+    record.marker = PERSIST_MARKER;
+    record.type = (uint8_t)type;
+    record.value = value;
+    record.incorrectCodes = state->incorrectCodes;
+    record.status = (uint8_t)((state->alarmState ? PERSIST_STATUS_ALARM : 0) |
+                              (state->code << PERSIST_STATUS_CODE_SHIFT));
+    record.flags = 0;
+    record.timestamp = (uint32_t)Kernel::Clock::now().time_since_epoch().count();
+    record.boot = bootNumber;
+
+    pendingAdd(&record);
+    if (recordUrgent(type)) {
+        persistFlush();
+    }
+}
+
+// Also true while an erase is still to be finished, which persistFlush() polls
+bool persistPending()
+{
+    return pendingCount > 0 || erasePending != 0;
+}
+
+// Programs the queued records, oldest first. The sector erase on a sector
+// change, once every 8192 records, takes a second or so: it is only started
+// here and runs in the background, later calls see it finish.
+void persistFlush()
+{
+    flashLock();
+    eraseStep();
+    while (pendingProgram()) {
+    }
+    flashUnlock();
+}
+
+// Starts sending the most recent records, oldest first, one
+// "[HISTORY] boot <n> <ms> ms <event> <value> codes <n> alarm <0|1>" line each,
+// by persistSendStep(). Reading bank 2 stalls the CPU until a sector erase on
+// it ends, so while one runs the history is left for later.
+void persistSendStart()
+{
+    char line[PERSIST_LINE_LENGTH];
+    size_t length = 0;
+
+    historyCount = 0;
+    historyNext = 0;
+    if (!flashReady) {
+        serialTxWriteLiteral("[HISTORY] Flash not available\r\n", TX_NEVER_DROP);
+        return;
+    }
+    persistFlush();
+    flashLock();
+    if (eraseRunning >= 0) {            // Cannot start another while the lock is held
+        flashUnlock();
+        serialTxWriteLiteral("[HISTORY] Sector erase running, try again in a few seconds\r\n", TX_NEVER_DROP);
+        return;
+    }
+
+    // Only the reads hold the lock, the alarm thread's urgent records must
+    // not wait for the console to drain
+    length += literalAppend(&line[length], "[HISTORY] ");
+    length += decimalWrite(&line[length], activeTail);
+    length += literalAppend(&line[length], " records, generation ");
+    length += decimalWrite(&line[length], activeGeneration);
+    length += literalAppend(&line[length], ", dropped ");
+    length += decimalWrite(&line[length], droppedRecords);
+    length += literalAppend(&line[length], "\r\n");
+
+    uint32_t first = activeTail > PERSIST_HISTORY_LINES ? activeTail - PERSIST_HISTORY_LINES : 0;
+    for (uint32_t index = first; index < activeTail; index++) {
+        persistRecord_t* record = &historyRecords[historyCount];
+
+        if (recordRead(activeSector, index, record) && !(record->flags & PERSIST_FLAG_SNAPSHOT)) {
+            historyCount++;
+        }
+    }
+    flashUnlock();
+
+    serialTxWrite(line, length, TX_NEVER_DROP);
+}
+
+// Sends the lines that fit the TX ring now, true once they are all sent
+bool persistSendStep()
+{
+    char line[PERSIST_LINE_LENGTH];
+
+    for (; historyNext < historyCount && serialTxRoom(PERSIST_LINE_LENGTH); historyNext++) {
+        const persistRecord_t* record = &historyRecords[historyNext];
+        int written = snprintf(line, sizeof(line), "[HISTORY] boot %u %lu ms%s%u codes %u alarm %c\r\n",
+                               (unsigned int)record->boot, (unsigned long)record->timestamp,
+                               eventLogName((eventType_t)record->type), (unsigned int)record->value,
+                               (unsigned int)record->incorrectCodes,
+                               (record->status & PERSIST_STATUS_ALARM) ? '1' : '0');
+        if (written < 0 || (size_t)written >= sizeof(line)) {
+            continue;                   // Never sent cut short
+        }
+        serialTxWrite(line, (size_t)written, TX_NEVER_DROP);
+    }
+    return historyNext >= historyCount;
+}
+
+//=====[Implementations of private functions]==================================
+
+static bool recordRead(int sector, uint32_t index, persistRecord_t* record)
+{
+    bd_addr_t address = (bd_addr_t)sector * PERSIST_SECTOR_SIZE + index * sizeof(persistRecord_t);
+
+    if (flash.read(record, address, sizeof(persistRecord_t)) != 0) {
+        return false;
+    }
+    return record->marker == PERSIST_MARKER &&
+           record->crc == crc16Ccitt((const uint8_t*)record, sizeof(persistRecord_t) - 2);
+}
+
+static bool recordBlank(int sector, uint32_t index)
+{
+    persistRecord_t record;
+    const uint8_t* bytes = (const uint8_t*)&record;
+
+    recordRead(sector, index, &record);
+    for (size_t i = 0; i < sizeof(record); i++) {
+        if (bytes[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns false, with nothing programmed, while an erase is still to finish
+static bool recordProgram(persistRecord_t* record)
+{
+    if (erasePending != 0) {
+        return false;
+    }
+    if (activeTail == PERSIST_RECORDS) {
+        sectorSwitch();
+    }
+
+    bd_addr_t address = (bd_addr_t)activeSector * PERSIST_SECTOR_SIZE +
+                        activeTail * sizeof(persistRecord_t);
+
+    record->generation = activeGeneration;
+    record->crc = crc16Ccitt((const uint8_t*)record, sizeof(persistRecord_t) - 2);
+    flash.program(record, address, sizeof(persistRecord_t));
+    activeTail++;                       // A failed program still uses up the slot
+    lastRecord = *record;
+    return true;
+}
+
+static bool recordUrgent(eventType_t type)
+{
+    return type == EVENT_CODE_ATTEMPT || type == EVENT_LOCKOUT ||
+           type == EVENT_CODE_SET || type == EVENT_ALARM || type == EVENT_ADMIN_REFUSED;
+}
+
+// First index of the blank part of the sector
+static uint32_t tailFind(int sector)
+{
+    uint32_t low = 0;
+    uint32_t high = PERSIST_RECORDS;
+
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (recordBlank(sector, middle)) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    return low;
+}
+
+// Only marks the sector, the erase itself is run by eraseStep()
+static void sectorErase(int sector)
+{
+    erasePending |= 1u << sector;
+}
+
+// Starts the erase of the next marked sector, or finishes the one running once
+// the flash is no longer busy. The log is in bank 2 and the code runs from
+// bank 1, so the CPU keeps running during the erase. Called with the flash lock
+// held, and a failed erase is retried.
+static void eraseStep()
+{
+    if (erasePending == 0 || (FLASH->SR & FLASH_SR_BSY)) {
+        return;
+    }
+
+    if (eraseRunning >= 0) {
+        bool failed = FLASH->SR & PERSIST_FLASH_ERRORS;
+        FLASH->SR = FLASH_SR_EOP | PERSIST_FLASH_ERRORS;
+        FLASH->CR &= ~(FLASH_CR_SER | FLASH_CR_SNB);
+        FLASH->CR |= FLASH_CR_LOCK;
+        if (FLASH->ACR & FLASH_ACR_DCEN) {  // The data cache may still hold the old contents
+            FLASH->ACR &= ~FLASH_ACR_DCEN;
+            FLASH->ACR |= FLASH_ACR_DCRST;
+            FLASH->ACR &= ~FLASH_ACR_DCRST;
+            FLASH->ACR |= FLASH_ACR_DCEN;
+        }
+        if (!failed) {
+            erasePending &= ~(1u << eraseRunning);
+        }
+        eraseRunning = -1;
+        return;
+    }
+
+    int sector = (erasePending & 1u) ? 0 : 1;
+    if (FLASH->CR & FLASH_CR_LOCK) {
+        FLASH->KEYR = FLASH_KEY1;
+        FLASH->KEYR = FLASH_KEY2;
+    }
+    FLASH->SR = FLASH_SR_EOP | PERSIST_FLASH_ERRORS;
+    FLASH->CR = (FLASH->CR & ~FLASH_CR_SNB) | FLASH_CR_PSIZE_1 | FLASH_CR_SER |
+                ((uint32_t)(PERSIST_FIRST_SNB + sector) << FLASH_CR_SNB_Pos);
+    FLASH->CR |= FLASH_CR_STRT;
+    eraseRunning = sector;
+}
+
+// The snapshot goes into the other sector, which was erased when it last
+// filled up, and the full sector is erased in the background
+static void sectorSwitch()
+{
+    int fullSector = activeSector;
+    persistRecord_t snapshot = lastRecord;
+
+    activeSector = 1 - fullSector;
+    activeGeneration++;
+    activeTail = 0;
+    snapshot.flags |= PERSIST_FLAG_SNAPSHOT;
+    recordProgram(&snapshot);
+    sectorErase(fullSector);
+}
+
+// The buffer only fills while an erase runs. Every record holds the whole
+// state, so the oldest one is then dropped: the newest is the one restored.
+static void pendingAdd(const persistRecord_t* record)
+{
+    core_util_critical_section_enter();
+    if (pendingCount == PERSIST_BUFFER_SIZE) {
+        memmove(&pendingRecords[0], &pendingRecords[1], (PERSIST_BUFFER_SIZE - 1) * sizeof(persistRecord_t));
+        pendingCount--;
+        droppedRecords++;
+    }
+    pendingRecords[pendingCount++] = *record;
+    core_util_critical_section_exit();
+}
+
+// Programs the oldest queued record, false when there is none or an erase
+// is still to finish. It leaves the queue only once it is in flash.
+static bool pendingProgram()
+{
+    persistRecord_t record;
+
+    core_util_critical_section_enter();
+    bool available = pendingCount > 0;
+    unsigned int dropped = droppedRecords;
+    if (available) {
+        record = pendingRecords[0];
+    }
+    core_util_critical_section_exit();
+
+    if (!available || !recordProgram(&record)) {
+        return false;
+    }
+
+    core_util_critical_section_enter();
+    if (droppedRecords == dropped) {    // Otherwise it was the record dropped meanwhile
+        pendingCount--;
+        memmove(&pendingRecords[0], &pendingRecords[1], pendingCount * sizeof(persistRecord_t));
+    }
+    core_util_critical_section_exit();
+    return true;
+}
+
+static void flashLock()
+{
+#if ALARM_THREADED
+    flashMutex.lock();
+#endif
+}
+
+static void flashUnlock()
+{
+#if ALARM_THREADED
+    flashMutex.unlock();
+#endif
+}
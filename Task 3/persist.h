@@ -0,0 +1,32 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _PERSIST_H_
+#define _PERSIST_H_
+
+//=====[Libraries]=============================================================
+
+#include <stdint.h>
+
+#include "event_log.h"
+
+//=====[Declaration of public data types]======================================
+
+// State that must survive a reset, taken from the last record in flash
+typedef struct {
+    bool alarmState;
+    uint8_t incorrectCodes;
+    uint8_t code;               // Deactivation code buttons, bit 0 for A, 0 if never set
+} persistState_t;
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+bool persistInit(persistState_t* state);
+void persistRecord(eventType_t type, uint8_t value, const persistState_t* state);
+bool persistPending();
+void persistFlush();
+void persistSendStart();
+bool persistSendStep();
+
+//=====[#include guards - end]=================================================
+
+#endif // _PERSIST_H_
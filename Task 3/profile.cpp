@@ -0,0 +1,186 @@
+//=====[Libraries]=============================================================
+
+#include "mbed.h"
+#include "arm_book_lib.h"
+
+#include "profile.h"
+
+#if ALARM_PROFILE
+
+#include "serial_tx.h"
+#include "text_format.h"
+
+//=====[Declaration of private defines]========================================
+
+#define PROFILE_HISTOGRAM_BINS  24      // Bin b counts latencies of 2^b to 2^(b+1) - 1 us
+#define PROFILE_LINE_LENGTH     64
+
+//=====[Declaration of private data types]=====================================
+
+typedef struct {
+    uint32_t count;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint64_t totalUs;
+} profileSample_t;
+
+//=====[Declaration and initialization of private global variables]============
+
+static profileSample_t stats[PROFILE_STATS];
+static profileSample_t edgeLatency;
+static uint32_t edgeHistogram[PROFILE_HISTOGRAM_BINS];
+
+// Cycle count of the first sensor edge not yet acted on, 0 when there is none
+static volatile uint32_t edgeStart = 0;
+static uint32_t cyclesPerUs = 1;
+
+static const char* const statNames[PROFILE_STATS] = {
+    "alarm ",
+    "uart ",
+    "report ",
+    "warning ",
+    "pass ",
+    "report slip ",
+};
+
+//=====[Declarations (prototypes) of private functions]========================
+
+static void sampleAdd(profileSample_t* sample, uint32_t us);
+static void sampleSend(const char* name, const profileSample_t* sample);
+
+//=====[Implementations of public functions]===================================
+
+// Uses the DWT cycle counter that the boot module has already started. It
+// runs at the core clock (180 MHz) and wraps after about 23 s, well beyond
+// anything it times.
+void profileInit()
+{
+    cyclesPerUs = SystemCoreClock / 1000000;
+
+    for (int i = 0; i < PROFILE_STATS; i++) {
+        stats[i] = {};
+    }
+    edgeLatency = {};
+}
+
+uint32_t profileStart()
+{
+    return DWT->CYCCNT;
+}
+
+void profileStageEnd(profileStat_t stat, uint32_t start)
+{
+    sampleAdd(&stats[stat], (DWT->CYCCNT - start) / cyclesPerUs);
+}
+
+void profileSampleAdd(profileStat_t stat, uint32_t us)
+{
+    sampleAdd(&stats[stat], us);
+}
+
+// Safe to call from interrupt context. Only the first edge is kept, so a
+// bouncing input is timed from when it started to bounce.
+void profileEdgeMark()
+{
+    if (edgeStart == 0) {
+        edgeStart = DWT->CYCCNT | 1;    // Never 0, at the cost of one cycle of resolution
+    }
+}
+
+// The alarm LED has been updated for a debounced sensor edge
+void profileEdgeDone()
+{
+    if (edgeStart == 0) {
+        return;
+    }
+
+    uint32_t us = (DWT->CYCCNT - edgeStart) / cyclesPerUs;
+    int bin = 0;
+
+    edgeStart = 0;
+    sampleAdd(&edgeLatency, us);
+    while ((us >> (bin + 1)) != 0 && bin < PROFILE_HISTOGRAM_BINS - 1) {
+        bin++;
+    }
+    edgeHistogram[bin]++;
+}
+
+// The edge was a glitch shorter than the debounce time, there is nothing to time
+void profileEdgeCancel()
+{
+    edgeStart = 0;
+}
+
+// "[STATS] <stage> <count> <min> <avg> <max>" in us, then the edge latency
+// histogram and the TX counters
+void profileSend()
+{
+    char line[PROFILE_LINE_LENGTH];
+    size_t length = 0;
+
+    serialTxWriteLiteral("[STATS] name count min avg max (us)\r\n", TX_NEVER_DROP);
+    for (int i = 0; i < PROFILE_STATS; i++) {
+        sampleSend(statNames[i], &stats[i]);
+    }
+    sampleSend("edge to LED ", &edgeLatency);
+
+    for (int bin = 0; bin < PROFILE_HISTOGRAM_BINS; bin++) {
+        if (edgeHistogram[bin] == 0) {
+            continue;
+        }
+        length = 0;
+        length += literalAppend(&line[length], "[STATS] edge to LED <");
+        length += decimalWrite(&line[length], 2u << bin);
+        length += literalAppend(&line[length], " us ");
+        length += decimalWrite(&line[length], edgeHistogram[bin]);
+        length += literalAppend(&line[length], "\r\n");
+        serialTxWrite(line, length, TX_NEVER_DROP);
+    }
+
+    length = 0;
+    length += literalAppend(&line[length], "[STATS] TX bytes ");
+    length += decimalWrite(&line[length], serialTxBytes());
+    length += literalAppend(&line[length], " dropped messages ");
+    length += decimalWrite(&line[length], serialTxDroppedMessages());
+    length += literalAppend(&line[length], "\r\n");
+    serialTxWrite(line, length, TX_NEVER_DROP);
+}
+
+//=====[Implementations of private functions]==================================
+
+// Stages are timed on more than one thread in the threaded build
+static void sampleAdd(profileSample_t* sample, uint32_t us)
+{
+    core_util_critical_section_enter();
+    if (sample->count == 0 || us < sample->minUs) {
+        sample->minUs = us;
+    }
+    if (us > sample->maxUs) {
+        sample->maxUs = us;
+    }
+    sample->totalUs += us;
+    sample->count++;
+    core_util_critical_section_exit();
+}
+
+static void sampleSend(const char* name, const profileSample_t* sample)
+{
+    char line[PROFILE_LINE_LENGTH];
+    size_t length = 0;
+    size_t nameLength = strlen(name);
+
+    length += literalAppend(&line[length], "[STATS] ");
+    memcpy(&line[length], name, nameLength);
+    length += nameLength;
+    length += decimalWrite(&line[length], sample->count);
+    line[length++] = ' ';
+    length += decimalWrite(&line[length], sample->minUs);
+    line[length++] = ' ';
+    length += decimalWrite(&line[length], sample->count ? (unsigned int)(sample->totalUs / sample->count) : 0);
+    line[length++] = ' ';
+    length += decimalWrite(&line[length], sample->maxUs);
+    length += literalAppend(&line[length], "\r\n");
+    serialTxWrite(line, length, TX_NEVER_DROP);
+}
+
+#endif
@@ -0,0 +1,52 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+//=====[Libraries]=============================================================
+
+#include <stdint.h>
+
+#include "alarm_config.h"
+
+//=====[Declaration of public data types]======================================
+
+typedef enum {
+    PROFILE_ALARM,              // alarmUpdate()
+    PROFILE_UART,               // uartTask(), including the commands it runs
+    PROFILE_REPORT,             // sendStatusReport()
+    PROFILE_WARNING,            // sendWarningIfNeeded()
+    PROFILE_PASS,               // One polling pass, or one queued handler
+    PROFILE_REPORT_SLIP,        // How late the periodic report started
+    PROFILE_STATS
+} profileStat_t;
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+#if ALARM_PROFILE
+
+void profileInit();
+uint32_t profileStart();
+void profileStageEnd(profileStat_t stat, uint32_t start);
+void profileSampleAdd(profileStat_t stat, uint32_t us);
+void profileEdgeMark();
+void profileEdgeDone();
+void profileEdgeCancel();
+void profileSend();
+
+#else
+
+inline void profileInit() {}
+inline uint32_t profileStart() { return 0; }
+inline void profileStageEnd(profileStat_t, uint32_t) {}
+inline void profileSampleAdd(profileStat_t, uint32_t) {}
+inline void profileEdgeMark() {}
+inline void profileEdgeDone() {}
+inline void profileEdgeCancel() {}
+inline void profileSend() {}
+
+#endif
+
+//=====[#include guards - end]=================================================
+
+#endif // _PROFILE_H_
@@ -0,0 +1,81 @@
+//=====[Libraries]=============================================================
+
+#include <string.h>
+
+#include "report.h"
+#include "telemetry.h"
+#include "text_format.h"
+
+//=====[Declaration of private defines]========================================
+
+// [Requirement (ii), (iii)]: Status report frames, built by the compiler for every combination
+// of alarm, gas and temperature state and indexed by the STATUS_*_BIT flags
+#define REPORT_FRAME(alarm, gas, temp) \
+    "\r\n[STATUS REPORT]\r\nAlarm: " alarm "\r\nGas: " gas "\r\nTemperature: " temp "\r\n\r\n"
+#define REPORT_FRAME_ENTRY(alarm, gas, temp) \
+    { REPORT_FRAME(alarm, gas, temp), literalLength(REPORT_FRAME(alarm, gas, temp)) }
+
+//=====[Declaration and initialization of public constants]====================
+
+const reportFrame_t reportFrames[8] = {
+    REPORT_FRAME_ENTRY("OFF", "Normal",   "Normal"),
+    REPORT_FRAME_ENTRY("OFF", "Normal",   "High"),
+    REPORT_FRAME_ENTRY("OFF", "Detected", "Normal"),
+    REPORT_FRAME_ENTRY("OFF", "Detected", "High"),
+    REPORT_FRAME_ENTRY("ON",  "Normal",   "Normal"),
+    REPORT_FRAME_ENTRY("ON",  "Normal",   "High"),
+    REPORT_FRAME_ENTRY("ON",  "Detected", "Normal"),
+    REPORT_FRAME_ENTRY("ON",  "Detected", "High"),
+};
+
+//=====[Implementations of public functions]===================================
+
+// STATUS_*_BIT flags of a state, the detector masks come from sensors.h
+uint8_t reportStatusBits(bool alarmState, inputMask_t sensors,
+                         inputMask_t gasDetectors, inputMask_t overTempDetectors)
+{
+    return (alarmState ? STATUS_ALARM_BIT : 0) |                    // Current alarm state
+           ((sensors & gasDetectors) ? STATUS_GAS_BIT : 0) |        // Any gas detector
+           ((sensors & overTempDetectors) ? STATUS_TEMP_BIT : 0);   // Any temperature detector
+}
+
+// Runs for an active sensor, onset is set on its first update since it became
+// active. True when a warning is due now, otherwise a suppressed onset is counted.
+bool reportWarningDue(reportWarning_t* warning, bool onset, uint32_t nowMs)
+{
+    if (onset) {
+        if (!warning->sent || nowMs - warning->lastSentMs >= WARNING_MIN_INTERVAL_MS) {
+            return true;
+        }
+        warning->suppressed++;
+        return false;
+    }
+    return nowMs - warning->lastSentMs >= WARNING_REPEAT_MS;   // Re-assert while still active
+}
+
+// Writes "<text>\r\n", or "<text> (<n> suppressed)\r\n" after suppressed onsets,
+// and returns the length. main.cpp checks every text in sensors[] fits in
+// WARNING_MAX_LENGTH this way.
+size_t reportWarningWrite(const reportWarning_t* warning, const char* text, char* buffer)
+{
+    size_t length = strlen(text);
+
+    memcpy(buffer, text, length);
+    if (warning->suppressed > 0) {
+        buffer[length++] = ' ';
+        buffer[length++] = '(';
+        length += decimalWrite(&buffer[length], warning->suppressed);
+        length += literalAppend(&buffer[length], " suppressed)");
+    }
+    buffer[length++] = '\r';
+    buffer[length++] = '\n';
+    return length;
+}
+
+// Called once the warning, text or packet, has been queued
+void reportWarningSent(reportWarning_t* warning, uint32_t nowMs)
+{
+    warning->sent = true;
+    warning->lastSentMs = nowMs;
+    warning->suppressed = 0;
+}
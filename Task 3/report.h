@@ -0,0 +1,54 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _REPORT_H_
+#define _REPORT_H_
+
+//=====[Libraries]=============================================================
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "inputs.h"
+
+//=====[Declaration of public defines]=========================================
+
+// [Requirement (iv)]: A warning is sent when its sensor becomes active and then re-asserted
+// every WARNING_REPEAT_MS while it stays active. Onsets closer together than
+// WARNING_MIN_INTERVAL_MS are not sent but counted in the next warning for that sensor.
+#ifndef WARNING_REPEAT_MS
+#define WARNING_REPEAT_MS       10000
+#endif
+#ifndef WARNING_MIN_INTERVAL_MS
+#define WARNING_MIN_INTERVAL_MS 1000
+#endif
+#define WARNING_MAX_LENGTH      64      // Longest warning, including the suppressed count
+
+//=====[Declaration of public data types]======================================
+
+typedef struct {
+    const char* text;
+    size_t length;
+} reportFrame_t;
+
+// Rate limiting state of the warning for one sensor, its text is in sensors[]
+typedef struct {
+    bool sent;                          // A warning has been sent since power on
+    uint32_t lastSentMs;                // Time of the last warning sent
+    unsigned int suppressed;            // Onsets not sent since the last warning
+} reportWarning_t;
+
+//=====[Declaration of public constants]=======================================
+
+extern const reportFrame_t reportFrames[8];
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+uint8_t reportStatusBits(bool alarmState, inputMask_t sensors,
+                         inputMask_t gasDetectors, inputMask_t overTempDetectors);
+bool reportWarningDue(reportWarning_t* warning, bool onset, uint32_t nowMs);
+size_t reportWarningWrite(const reportWarning_t* warning, const char* text, char* buffer);
+void reportWarningSent(reportWarning_t* warning, uint32_t nowMs);
+
+//=====[#include guards - end]=================================================
+
+#endif // _REPORT_H_
@@ -0,0 +1,102 @@
+//=====[Libraries]=============================================================
+
+#include "mbed.h"
+#include "arm_book_lib.h"
+
+#include "scheduler.h"
+
+//=====[Declaration of private data types]=====================================
+
+// Deadlines are absolute Kernel::Clock ticks (1 ms). A job's next deadline is
+// its previous one plus the period, so the time its function takes to run,
+// or the caller being late, never shifts the phase of later runs.
+typedef struct {
+    schedulerFunction_t function;
+    Kernel::Clock::duration period;
+    Kernel::Clock::time_point deadline;
+    bool running;
+} job_t;
+
+//=====[Declaration and initialization of private global variables]============
+
+static job_t jobs[SCHEDULER_MAX_JOBS];
+static int numberOfJobs = 0;
+static Kernel::Clock::duration runningLateness = Kernel::Clock::duration::zero();
+
+//=====[Implementations of public functions]===================================
+
+void schedulerInit()
+{
+    numberOfJobs = 0;
+}
+
+// Jobs are added once at start up and start stopped
+schedulerJob_t schedulerJobAdd(schedulerFunction_t function, uint32_t periodMs)
+{
+    MBED_ASSERT(numberOfJobs < SCHEDULER_MAX_JOBS);
+
+    jobs[numberOfJobs].function = function;
+    jobs[numberOfJobs].period = Kernel::Clock::duration(periodMs);
+    jobs[numberOfJobs].running = false;
+    return numberOfJobs++;
+}
+
+// Starts, or restarts, the job with its first run one period from now
+void schedulerJobStart(schedulerJob_t job)
+{
+    jobs[job].deadline = Kernel::Clock::now() + jobs[job].period;
+    jobs[job].running = true;
+}
+
+void schedulerJobStop(schedulerJob_t job)
+{
+    jobs[job].running = false;
+}
+
+// Takes effect from now if the job is running
+void schedulerJobPeriodWrite(schedulerJob_t job, uint32_t periodMs)
+{
+    jobs[job].period = Kernel::Clock::duration(periodMs);
+    if (jobs[job].running) {
+        schedulerJobStart(job);
+    }
+}
+
+bool schedulerJobRunning(schedulerJob_t job)
+{
+    return jobs[job].running;
+}
+
+// Runs every job whose deadline has passed. Missed periods are skipped rather
+// than run back to back.
+void schedulerRun()
+{
+    Kernel::Clock::time_point now = Kernel::Clock::now();
+
+    for (int i = 0; i < numberOfJobs; i++) {
+        if (jobs[i].running && jobs[i].deadline <= now) {
+            runningLateness = now - jobs[i].deadline;
+            jobs[i].deadline += jobs[i].period * ((now - jobs[i].deadline) / jobs[i].period + 1);
+            jobs[i].function();         // May stop or restart its own job
+        }
+    }
+}
+
+// How far past its deadline the job being run by schedulerRun() was started
+Kernel::Clock::duration schedulerLateness()
+{
+    return runningLateness;
+}
+
+// Earliest deadline of the running jobs, or time_point::max() if none is running
+Kernel::Clock::time_point schedulerNextDeadline()
+{
+    Kernel::Clock::time_point next = Kernel::Clock::time_point::max();
+
+    for (int i = 0; i < numberOfJobs; i++) {
+        if (jobs[i].running && jobs[i].deadline < next) {
+            next = jobs[i].deadline;
+        }
+    }
+    return next;
+}
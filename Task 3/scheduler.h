@@ -0,0 +1,34 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+//=====[Libraries]=============================================================
+
+#include "mbed.h"
+
+//=====[Declaration of public defines]=========================================
+
+#define SCHEDULER_MAX_JOBS      10
+
+//=====[Declaration of public data types]======================================
+
+typedef void (*schedulerFunction_t)();
+typedef int schedulerJob_t;             // Index returned by schedulerJobAdd()
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+void schedulerInit();
+schedulerJob_t schedulerJobAdd(schedulerFunction_t function, uint32_t periodMs);
+void schedulerJobStart(schedulerJob_t job);
+void schedulerJobStop(schedulerJob_t job);
+void schedulerJobPeriodWrite(schedulerJob_t job, uint32_t periodMs);
+bool schedulerJobRunning(schedulerJob_t job);
+
+void schedulerRun();
+Kernel::Clock::duration schedulerLateness();
+Kernel::Clock::time_point schedulerNextDeadline();
+
+//=====[#include guards - end]=================================================
+
+#endif // _SCHEDULER_H_
@@ -0,0 +1,96 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _SENSORS_H_
+#define _SENSORS_H_
+
+//=====[Libraries]=============================================================
+
+#include "mbed.h"
+
+#include "alarm_config.h"
+#include "inputs.h"
+
+//=====[Declaration of public data types]======================================
+
+typedef enum {
+    SENSOR_GAS,
+    SENSOR_TEMPERATURE,
+} sensorType_t;
+
+typedef enum {
+    SENSOR_SEVERITY_WARNING,    // Warnings may be dropped when the TX ring is full
+    SENSOR_SEVERITY_CRITICAL,   // Warnings wait for space, like alarm transitions
+} sensorSeverity_t;
+
+typedef struct {
+    PinName pin;
+    sensorType_t type;
+    bool analog;                // Level scanned by the analog module instead of a digital input
+    uint16_t debounceMs;
+    uint16_t thresholdMv;       // Analog only: active once the level reaches this,
+    uint16_t hysteresisMv;      // until it falls this far below it
+    sensorSeverity_t severity;
+    const char* warning;        // [Requirement (iv)]: Warning text without the line ending
+} sensor_t;
+
+//=====[Declaration and initialization of public constants]====================
+
+// Every detector on the board. Sensor i is bit i of an input snapshot, so
+// adding one is a line here: the loop, the reports and the warnings all walk
+// the snapshot bits. Up to INPUT_SENSOR_LIMIT sensors, each on its own pin
+// number (EXTI line) and on one of the ports read by the inputs module.
+// Analog sensors need an ADC1 pin instead and are debounced by block averaging.
+static constexpr sensor_t sensors[] = {
+    { D2, SENSOR_GAS,         false, SENSOR_DEBOUNCE_MS, 0, 0,
+      SENSOR_SEVERITY_WARNING, "[WARNING] Gas levels unsafe!" },
+    { D3, SENSOR_TEMPERATURE, false, SENSOR_DEBOUNCE_MS, 0, 0,
+      SENSOR_SEVERITY_WARNING, "[WARNING] Temperature too high!" },
+#if ALARM_ANALOG
+    { A0, SENSOR_GAS,         true,  0, ANALOG_GAS_THRESHOLD_MV, ANALOG_GAS_HYSTERESIS_MV,
+      SENSOR_SEVERITY_WARNING, "[WARNING] Gas concentration unsafe!" },
+    { A1, SENSOR_TEMPERATURE, true,  0, ANALOG_TEMP_THRESHOLD_MV, ANALOG_TEMP_HYSTERESIS_MV,
+      SENSOR_SEVERITY_WARNING, "[WARNING] Temperature level too high!" },
+#endif
+};
+
+#define SENSOR_COUNT            ((int)(sizeof(sensors) / sizeof(sensors[0])))
+
+static_assert(SENSOR_COUNT <= INPUT_SENSOR_LIMIT, "Too many sensors for the input snapshot");
+
+//=====[Implementations of public functions]===================================
+
+// Snapshot bits of the sensors of one type
+static constexpr inputMask_t sensorsOfType(sensorType_t type)
+{
+    inputMask_t mask = 0;
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        if (sensors[i].type == type) {
+            mask |= (inputMask_t)1 << i;
+        }
+    }
+    return mask;
+}
+
+// Snapshot bits of the analog sensors
+static constexpr inputMask_t sensorsAnalog()
+{
+    inputMask_t mask = 0;
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        if (sensors[i].analog) {
+            mask |= (inputMask_t)1 << i;
+        }
+    }
+    return mask;
+}
+
+static constexpr inputMask_t INPUT_GAS_DETECTORS = sensorsOfType(SENSOR_GAS);
+static constexpr inputMask_t INPUT_OVER_TEMP_DETECTORS = sensorsOfType(SENSOR_TEMPERATURE);
+static constexpr inputMask_t INPUT_ANALOG_SENSORS = sensorsAnalog();
+
+#define SENSOR_ANALOG_COUNT     __builtin_popcount(INPUT_ANALOG_SENSORS)
+
+//=====[#include guards - end]=================================================
+
+#endif // _SENSORS_H_
@@ -0,0 +1,86 @@
+//=====[Libraries]=============================================================
+
+#include "mbed.h"
+#include "arm_book_lib.h"
+
+#include "serial_rx.h"
+
+//=====[Declaration of private defines]========================================
+
+#define RX_RING_SIZE            256     // Must be a power of two
+
+//=====[Declaration of external public global objects]=========================
+
+extern UnbufferedSerial uartUsb;
+
+//=====[Declaration and initialization of private global variables]============
+
+// Single producer (RX interrupt), single consumer (uartTask). head and tail
+// run freely and are masked on access.
+static char rxRing[RX_RING_SIZE];
+static volatile uint16_t rxHead = 0;
+static volatile uint16_t rxTail = 0;
+
+static serialRxNotify_t rxNotify = nullptr;
+static volatile unsigned int rxOverruns = 0;
+
+//=====[Declarations (prototypes) of private functions]========================
+
+static void serialRxIsr();
+
+//=====[Implementations of public functions]===================================
+
+// notify, if given, runs in interrupt context after characters are received
+void serialRxInit(serialRxNotify_t notify)
+{
+    rxNotify = notify;
+    rxHead = rxTail = 0;
+    serialRxAttach();
+}
+
+void serialRxAttach()
+{
+    uartUsb.attach(serialRxIsr, SerialBase::RxIrq);
+}
+
+// Releases the RX interrupt, and with it the deep sleep lock it holds
+void serialRxDetach()
+{
+    uartUsb.attach(nullptr, SerialBase::RxIrq);
+}
+
+bool serialRxRead(char* receivedChar)
+{
+    if (rxHead == rxTail) {
+        return false;
+    }
+    *receivedChar = rxRing[rxHead & (RX_RING_SIZE - 1)];
+    rxHead = rxHead + 1;
+    return true;
+}
+
+// Characters lost because the ring was full
+unsigned int serialRxOverruns()
+{
+    return rxOverruns;
+}
+
+//=====[Implementations of private functions]==================================
+
+// Runs in interrupt context: reading the character clears the RX interrupt
+static void serialRxIsr()
+{
+    char receivedChar = '\0';
+
+    while (uartUsb.readable() && uartUsb.read(&receivedChar, 1) == 1) {
+        if ((uint16_t)(rxTail - rxHead) < RX_RING_SIZE) {
+            rxRing[rxTail & (RX_RING_SIZE - 1)] = receivedChar;
+            rxTail = rxTail + 1;
+        } else {
+            rxOverruns = rxOverruns + 1;
+        }
+    }
+    if (rxNotify != nullptr) {
+        rxNotify();
+    }
+}
@@ -0,0 +1,20 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _SERIAL_RX_H_
+#define _SERIAL_RX_H_
+
+//=====[Declaration of public data types]======================================
+
+typedef void (*serialRxNotify_t)();
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+void serialRxInit(serialRxNotify_t notify);
+void serialRxAttach();
+void serialRxDetach();
+bool serialRxRead(char* receivedChar);
+unsigned int serialRxOverruns();
+
+//=====[#include guards - end]=================================================
+
+#endif // _SERIAL_RX_H_
@@ -0,0 +1,305 @@
+//=====[Libraries]=============================================================
+
+#include "mbed.h"
+#include "arm_book_lib.h"
+
+#include "alarm_config.h"
+#include "serial_tx.h"
+
+#if !ALARM_MODBUS
+
+//=====[Declaration of private defines]========================================
+
+#define TX_RING_SIZE            512     // Bytes per ring, must be a power of two
+#define TX_RECORD_MAX_LENGTH    128     // Longer writes are split into several records
+#define TX_RESERVE              128     // Never-drop bytes serialTxRoom() keeps for alarm messages and replies
+
+//=====[Declaration of private data types]=====================================
+
+// Byte ring holding whole records, each one a length byte followed by the data.
+// head and tail run freely and are masked on access.
+typedef struct {
+    char buffer[TX_RING_SIZE];
+    uint16_t head;
+    uint16_t tail;
+} txRing_t;
+
+//=====[Declaration of external public global objects]=========================
+
+extern UnbufferedSerial uartUsb;
+
+//=====[Declaration and initialization of private global variables]============
+
+// Records with TX_NEVER_DROP go to their own ring and are sent first, so a
+// burst of warnings can neither push them out nor hold them back
+static txRing_t neverDropRing;
+static txRing_t dropOldestRing;
+
+// The record being transmitted is moved out of its ring, so the rings only
+// ever hold records that can still be discarded whole
+static char txRecord[TX_RECORD_MAX_LENGTH];
+static size_t txRecordLength = 0;
+static size_t txRecordIndex = 0;
+
+#if ANALOG_STREAM
+// A bulk frame is sent from the caller's buffer by DMA1 stream 3 (channel 4,
+// USART3 TX), after both rings are empty. One frame waits while another is
+// sent, so a caller with two buffers can fill one while the other goes out.
+#define TX_DMA_CHANNEL          4
+static const char* volatile txFramePending = nullptr;
+static size_t txFramePendingLength = 0;
+static size_t txFrameLength = 0;
+#endif
+
+static serialTxTextHook_t textHook = nullptr;
+
+static volatile bool txActive = false;
+static unsigned int droppedMessages = 0;
+static volatile unsigned int txBytes = 0;
+
+//=====[Declarations (prototypes) of private functions]========================
+
+static size_t ringFree(const txRing_t* ring);
+static void ringPush(txRing_t* ring, const char* data, size_t length);
+static void ringDropRecord(txRing_t* ring);
+static size_t ringPopRecord(txRing_t* ring, char* data);
+static void txStart();
+static void serialTxIsr();
+#if ANALOG_STREAM
+static void txFrameStart();
+static void txFrameDmaIsr();
+#endif
+
+//=====[Implementations of public functions]===================================
+
+void serialTxInit()
+{
+    neverDropRing.head = neverDropRing.tail = 0;
+    dropOldestRing.head = dropOldestRing.tail = 0;
+    txRecordLength = txRecordIndex = 0;
+    txActive = false;
+#if ANALOG_STREAM
+    RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN;
+    NVIC_SetVector(DMA1_Stream3_IRQn, (uint32_t)txFrameDmaIsr);
+    NVIC_EnableIRQ(DMA1_Stream3_IRQn);
+#endif
+}
+
+// Queues text for transmission without waiting for the UART, or hands it to
+// the text hook when one is set. With TX_NEVER_DROP it waits for space once
+// the ring is full, so it must not be called from interrupt context then.
+// Long output is sent in pieces that pass serialTxRoom(), which keeps the wait
+// for short writes to a few ms at most.
+void serialTxWrite(const char* data, size_t length, serialTxPolicy_t policy)
+{
+    serialTxTextHook_t hook = textHook;
+
+    if (hook != nullptr) {
+        hook(data, length, policy);
+    } else {
+        serialTxBinaryWrite(data, length, policy);
+    }
+}
+
+// Like serialTxWrite() but never passed to the text hook, for bytes already
+// framed by the caller. A write of at most TX_RECORD_MAX_LENGTH bytes is one
+// record, so TX_DROP_OLDEST discards it whole or not at all.
+void serialTxBinaryWrite(const char* data, size_t length, serialTxPolicy_t policy)
+{
+    txRing_t* ring = (policy == TX_NEVER_DROP) ? &neverDropRing : &dropOldestRing;
+
+    while (length > 0) {
+        size_t recordLength = (length > TX_RECORD_MAX_LENGTH) ? TX_RECORD_MAX_LENGTH : length;
+        bool queued = false;
+
+        while (!queued) {
+            core_util_critical_section_enter();
+            if (policy == TX_DROP_OLDEST) {
+                while (ringFree(ring) < recordLength + 1) {
+                    ringDropRecord(ring);
+                    droppedMessages++;
+                }
+            }
+            if (ringFree(ring) >= recordLength + 1) {
+                char header = (char)recordLength;
+                ringPush(ring, &header, 1);
+                ringPush(ring, data, recordLength);
+                queued = true;
+            }
+            core_util_critical_section_exit();
+
+            txStart();                  // Keeps draining while a never-drop write waits
+        }
+
+        data += recordLength;
+        length -= recordLength;
+    }
+}
+
+// Routes every later serialTxWrite() through hook, or back to the rings with
+// nullptr. Binary telemetry uses it to wrap replies in packets.
+void serialTxTextHookSet(serialTxTextHook_t hook)
+{
+    textHook = hook;
+}
+
+// True when a TX_NEVER_DROP write of length bytes would be queued at once
+// and still leave TX_RESERVE bytes free. Long output is sent a piece at a
+// time while this holds, so it never waits for the UART and a short message
+// written meanwhile never waits for it. Text wrapped in packets by the hook
+// grows by 12 bytes per 48, which TX_RESERVE absorbs.
+bool serialTxRoom(size_t length)
+{
+    size_t needed = length + (length + TX_RECORD_MAX_LENGTH - 1) / TX_RECORD_MAX_LENGTH;
+
+    return ringFree(&neverDropRing) >= needed + TX_RESERVE;
+}
+
+bool serialTxIdle()
+{
+    return !txActive;
+}
+
+unsigned int serialTxDroppedMessages()
+{
+    return droppedMessages;
+}
+
+// Bytes handed to the UART since power on
+unsigned int serialTxBytes()
+{
+    return txBytes;
+}
+
+#if ANALOG_STREAM
+// Queues a frame that is sent after every queued record and never copied:
+// the DMA reads data in place, so it must stay untouched until a later frame
+// has been accepted and serialTxFrameBusy() is false. Returns false, and the
+// frame is dropped, when one is already waiting. Safe in interrupt context.
+bool serialTxFrameSend(const char* data, size_t length)
+{
+    bool accepted = false;
+
+    core_util_critical_section_enter();
+    if (txFramePending == nullptr) {
+        txFramePending = data;
+        txFramePendingLength = length;
+        accepted = true;
+    }
+    core_util_critical_section_exit();
+
+    if (accepted) {
+        txStart();
+    }
+    return accepted;
+}
+
+// A frame is waiting for the UART, serialTxFrameSend would refuse another
+bool serialTxFrameBusy()
+{
+    return txFramePending != nullptr;
+}
+#endif
+
+//=====[Implementations of private functions]==================================
+
+static size_t ringFree(const txRing_t* ring)
+{
+    return TX_RING_SIZE - (uint16_t)(ring->tail - ring->head);
+}
+
+static void ringPush(txRing_t* ring, const char* data, size_t length)
+{
+    for (size_t i = 0; i < length; i++) {
+        ring->buffer[ring->tail++ & (TX_RING_SIZE - 1)] = data[i];
+    }
+}
+
+static void ringDropRecord(txRing_t* ring)
+{
+    size_t length = (uint8_t)ring->buffer[ring->head & (TX_RING_SIZE - 1)];
+    ring->head += length + 1;
+}
+
+static size_t ringPopRecord(txRing_t* ring, char* data)
+{
+    if (ring->head == ring->tail) {
+        return 0;
+    }
+    size_t length = (uint8_t)ring->buffer[ring->head++ & (TX_RING_SIZE - 1)];
+    for (size_t i = 0; i < length; i++) {
+        data[i] = ring->buffer[ring->head++ & (TX_RING_SIZE - 1)];
+    }
+    return length;
+}
+
+static void txStart()
+{
+    core_util_critical_section_enter();
+    if (!txActive) {
+        txActive = true;
+        uartUsb.attach(serialTxIsr, SerialBase::TxIrq);  // TX register is empty, so this fires at once
+    }
+    core_util_critical_section_exit();
+}
+
+// Runs in interrupt context each time the UART can take another byte
+static void serialTxIsr()
+{
+    while (uartUsb.writable()) {
+        if (txRecordIndex == txRecordLength) {
+            txRecordIndex = 0;
+            txRecordLength = ringPopRecord(&neverDropRing, txRecord);
+            if (txRecordLength == 0) {
+                txRecordLength = ringPopRecord(&dropOldestRing, txRecord);
+            }
+            if (txRecordLength == 0) {
+                uartUsb.attach(nullptr, SerialBase::TxIrq);  // Nothing left, stop the TX interrupt
+#if ANALOG_STREAM
+                if (txFramePending != nullptr) {
+                    txFrameStart();     // txActive stays set until the DMA is done
+                    return;
+                }
+#endif
+                txActive = false;
+                return;
+            }
+        }
+        uartUsb.write(&txRecord[txRecordIndex++], 1);
+        txBytes = txBytes + 1;
+    }
+}
+
+#if ANALOG_STREAM
+// Runs in interrupt context with the TX interrupt detached
+static void txFrameStart()
+{
+    txFrameLength = txFramePendingLength;
+    DMA1_Stream3->CR = 0;
+    DMA1->LIFCR = DMA_LIFCR_CTCIF3 | DMA_LIFCR_CHTIF3 | DMA_LIFCR_CTEIF3 |
+                  DMA_LIFCR_CDMEIF3 | DMA_LIFCR_CFEIF3;
+    DMA1_Stream3->PAR = (uint32_t)&USART3->DR;
+    DMA1_Stream3->M0AR = (uint32_t)txFramePending;
+    DMA1_Stream3->NDTR = txFrameLength;
+    txFramePending = nullptr;           // The next frame may now be queued
+    DMA1_Stream3->CR = ((uint32_t)TX_DMA_CHANNEL << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_MINC |
+                       DMA_SxCR_DIR_0 | DMA_SxCR_TCIE | DMA_SxCR_TEIE | DMA_SxCR_EN;
+    USART3->CR3 |= USART_CR3_DMAT;
+}
+
+// Frame sent, hand the UART back to the rings or to the next frame
+static void txFrameDmaIsr()
+{
+    DMA1->LIFCR = DMA_LIFCR_CTCIF3 | DMA_LIFCR_CHTIF3 | DMA_LIFCR_CTEIF3 |
+                  DMA_LIFCR_CDMEIF3 | DMA_LIFCR_CFEIF3;
+    USART3->CR3 &= ~USART_CR3_DMAT;
+    txBytes = txBytes + (txFrameLength - DMA1_Stream3->NDTR);
+    txActive = false;
+    if (neverDropRing.head != neverDropRing.tail || dropOldestRing.head != dropOldestRing.tail ||
+        txFramePending != nullptr) {
+        txStart();
+    }
+}
+#endif
+
+#endif
@@ -0,0 +1,66 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _SERIAL_TX_H_
+#define _SERIAL_TX_H_
+
+//=====[Libraries]=============================================================
+
+#include <stddef.h>
+
+#include "alarm_config.h"
+
+//=====[Declaration of public data types]======================================
+
+// What happens to a message when its TX ring is full
+typedef enum {
+    TX_DROP_OLDEST,     // Discard the oldest queued messages of this class (warnings)
+    TX_NEVER_DROP,      // Wait for the TX interrupt to free space (alarm transitions, replies)
+} serialTxPolicy_t;
+
+// Takes over text writes, see serialTxTextHookSet()
+typedef void (*serialTxTextHook_t)(const char* data, size_t length, serialTxPolicy_t policy);
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+#if !ALARM_MODBUS
+
+void serialTxInit();
+void serialTxWrite(const char* data, size_t length, serialTxPolicy_t policy);
+void serialTxBinaryWrite(const char* data, size_t length, serialTxPolicy_t policy);
+void serialTxTextHookSet(serialTxTextHook_t hook);
+bool serialTxRoom(size_t length);
+bool serialTxIdle();
+unsigned int serialTxDroppedMessages();
+unsigned int serialTxBytes();
+bool serialTxFrameSend(const char* data, size_t length);
+bool serialTxFrameBusy();
+
+#else
+
+// The Modbus bus only carries responses to requests, see modbus.cpp, so the
+// text output is left out of the build
+inline void serialTxInit() {}
+inline void serialTxWrite(const char*, size_t, serialTxPolicy_t) {}
+inline void serialTxBinaryWrite(const char*, size_t, serialTxPolicy_t) {}
+inline void serialTxTextHookSet(serialTxTextHook_t) {}
+inline bool serialTxRoom(size_t) { return true; }
+inline bool serialTxIdle() { return true; }
+inline unsigned int serialTxDroppedMessages() { return 0; }
+inline unsigned int serialTxBytes() { return 0; }
+inline bool serialTxFrameSend(const char*, size_t) { return false; }
+inline bool serialTxFrameBusy() { return false; }
+
+#endif
+
+//=====[Implementations of public template functions]==========================
+
+// Queues a string literal, so fixed messages never need a hand-counted length
+template <size_t N>
+inline void serialTxWriteLiteral(const char (&text)[N], serialTxPolicy_t policy)
+{
+    serialTxWrite(text, N - 1, policy);
+}
+
+//=====[#include guards - end]=================================================
+
+#endif // _SERIAL_TX_H_
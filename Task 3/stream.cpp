@@ -0,0 +1,181 @@
+//=====[Libraries]=============================================================
+
+#include "mbed.h"
+#include "arm_book_lib.h"
+
+#include "alarm_config.h"
+#include "stream.h"
+
+#if ANALOG_STREAM
+
+#include "analog.h"
+#include "sensors.h"
+#include "serial_tx.h"
+#include "telemetry.h"
+#include "text_format.h"
+
+//=====[Declaration of private defines]========================================
+
+// One TELEMETRY_PACKET_SAMPLES packet per ADC block, payload:
+//   [0]    number of channels n
+//   [1]    decimation, each sample is the average of this many scans
+//   [2]    number of scans m in the packet
+//   [3]    block counter, a gap means dropped packets
+//   [4..]  n bytes, index in sensors[] of each channel
+//   then   n little endian u16 raw counts of the first scan
+//   then   (m - 1) * n zigzag varints, scan by scan, each the difference
+//          from the same channel's previous sample
+// Every packet starts from absolute counts, so a dropped one loses nothing else.
+#define STREAM_HEADER_LENGTH    4
+#define STREAM_PAYLOAD_MAX      (STREAM_HEADER_LENGTH + \
+                                 SENSOR_ANALOG_COUNT * (3 + 2 * (ANALOG_BLOCK_SCANS - 1)))
+#define STREAM_STATUS_LENGTH    96
+
+static_assert(ANALOG_BLOCK_SCANS % ANALOG_STREAM_DECIMATION == 0,
+              "ANALOG_STREAM_DECIMATION must divide ANALOG_BLOCK_SCANS");
+
+//=====[Declaration and initialization of private global variables]============
+
+// While one frame is sent by DMA the next block is encoded into the other
+static uint8_t streamPacket[TELEMETRY_PACKET_LENGTH(STREAM_PAYLOAD_MAX)];
+static uint8_t streamFrames[2][TELEMETRY_FRAME_LENGTH(STREAM_PAYLOAD_MAX)];
+static int streamNextFrame = 0;
+
+static volatile unsigned int streamDecimation = 0;     // 0 when stopped
+static uint8_t streamBlockCounter = 0;
+static volatile unsigned int streamFramesSent = 0;
+static volatile unsigned int streamFramesDropped = 0;
+
+//=====[Declarations (prototypes) of private functions]========================
+
+static void streamBlock(const uint16_t* block);
+static size_t varintWrite(uint8_t* buffer, int32_t value);
+
+//=====[Implementations of public functions]===================================
+
+void streamInit()
+{
+    analogBlockAttach(streamBlock);
+}
+
+// decimation must divide ANALOG_BLOCK_SCANS, so each packet carries whole averages
+bool streamStart(unsigned int decimation)
+{
+    if (decimation == 0 || decimation > ANALOG_BLOCK_SCANS ||
+        ANALOG_BLOCK_SCANS % decimation != 0) {
+        return false;
+    }
+    streamDecimation = decimation;
+    return true;
+}
+
+void streamStop()
+{
+    streamDecimation = 0;
+}
+
+// "Stream: off" or the decimation, resulting rate and frame counters
+void streamStatusSend()
+{
+    char buffer[STREAM_STATUS_LENGTH];
+    size_t length = 0;
+    unsigned int decimation = streamDecimation;
+
+    length += literalAppend(&buffer[length], "Stream: ");
+    if (decimation == 0) {
+        length += literalAppend(&buffer[length], "off");
+    } else {
+        length += literalAppend(&buffer[length], "decimation ");
+        length += decimalWrite(&buffer[length], decimation);
+        length += literalAppend(&buffer[length], ", ");
+        length += decimalWrite(&buffer[length], ANALOG_SCAN_HZ / decimation);
+        length += literalAppend(&buffer[length], " samples/s per channel");
+    }
+    length += literalAppend(&buffer[length], ", sent ");
+    length += decimalWrite(&buffer[length], streamFramesSent);
+    length += literalAppend(&buffer[length], ", dropped ");
+    length += decimalWrite(&buffer[length], streamFramesDropped);
+    length += literalAppend(&buffer[length], "\r\n");
+    serialTxWrite(buffer, length, TX_NEVER_DROP);
+}
+
+//=====[Implementations of private functions]==================================
+
+// Runs in interrupt context on every ADC block. The block is read straight
+// from the DMA buffer; when the previous frame has not left yet the block is
+// skipped, so streaming never holds up the alarm messages.
+static void streamBlock(const uint16_t* block)
+{
+    unsigned int decimation = streamDecimation;
+
+    if (decimation == 0) {
+        return;
+    }
+    streamBlockCounter++;
+    if (serialTxFrameBusy()) {
+        streamFramesDropped = streamFramesDropped + 1;
+        return;
+    }
+
+    uint8_t* payload = &streamPacket[TELEMETRY_HEADER_LENGTH];
+    int scans = ANALOG_BLOCK_SCANS / decimation;
+    uint16_t previous[SENSOR_ANALOG_COUNT];
+    size_t length = 0;
+
+    payload[length++] = (uint8_t)SENSOR_ANALOG_COUNT;
+    payload[length++] = (uint8_t)decimation;
+    payload[length++] = (uint8_t)scans;
+    payload[length++] = streamBlockCounter;
+    for (inputMask_t m = INPUT_ANALOG_SENSORS; m != 0; m &= m - 1) {
+        payload[length++] = (uint8_t)inputLowest(m);
+    }
+
+    for (int scan = 0; scan < scans; scan++) {
+        const uint16_t* first = &block[scan * decimation * SENSOR_ANALOG_COUNT];
+
+        for (int channel = 0; channel < SENSOR_ANALOG_COUNT; channel++) {
+            uint32_t sum = 0;
+
+            for (unsigned int i = 0; i < decimation; i++) {
+                sum += first[i * SENSOR_ANALOG_COUNT + channel];
+            }
+            uint16_t sample = (uint16_t)(sum / decimation);
+
+            if (scan == 0) {
+                payload[length++] = (uint8_t)sample;
+                payload[length++] = (uint8_t)(sample >> 8);
+            } else {
+                length += varintWrite(&payload[length], (int32_t)sample - previous[channel]);
+            }
+            previous[channel] = sample;
+        }
+    }
+
+    uint8_t* frame = streamFrames[streamNextFrame];
+    size_t frameLength = telemetryFrameBuild(TELEMETRY_PACKET_SAMPLES, streamPacket, length, frame);
+
+    if (serialTxFrameSend((const char*)frame, frameLength)) {
+        streamNextFrame ^= 1;
+        streamFramesSent = streamFramesSent + 1;
+    } else {
+        streamFramesDropped = streamFramesDropped + 1;
+    }
+}
+
+// Zigzag maps small differences of either sign to small numbers, then 7 bits
+// per byte, low first, with the top bit set on all but the last byte. 12 bit
+// differences take at most 2 bytes.
+static size_t varintWrite(uint8_t* buffer, int32_t value)
+{
+    uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    size_t length = 0;
+
+    while (zigzag >= 0x80) {
+        buffer[length++] = (uint8_t)(zigzag | 0x80);
+        zigzag >>= 7;
+    }
+    buffer[length++] = (uint8_t)zigzag;
+    return length;
+}
+
+#endif
@@ -0,0 +1,15 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _STREAM_H_
+#define _STREAM_H_
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+void streamInit();
+bool streamStart(unsigned int decimation);
+void streamStop();
+void streamStatusSend();
+
+//=====[#include guards - end]=================================================
+
+#endif // _STREAM_H_
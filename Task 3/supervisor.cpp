@@ -0,0 +1,211 @@
+//=====[Libraries]=============================================================
+
+#include "mbed.h"
+#include "arm_book_lib.h"
+
+#include "supervisor.h"
+
+#if ALARM_SUPERVISOR
+
+#include "serial_tx.h"
+#include "text_format.h"
+
+//=====[Declaration of private defines]========================================
+
+#define SUPERVISOR_MAGIC        0x53555052u     // "SUPR", anything else is power-on garbage
+#define SUPERVISOR_NO_TASK      0xFF
+#define SUPERVISOR_LINE_LENGTH  96
+
+//=====[Declaration of private data types]=====================================
+
+typedef enum {
+    RESET_POWER_ON,
+    RESET_PIN,
+    RESET_SOFTWARE,
+    RESET_WATCHDOG,
+    RESET_LOW_POWER,            // Entering standby or stop when the option bytes forbid it
+    RESET_CAUSES
+} resetCause_t;
+
+// Kept in the 4 KB backup SRAM, which a reset of any kind leaves untouched,
+// so the counts of the run that ended in a watchdog reset can still be read
+typedef struct {
+    uint32_t magic;
+    uint32_t boots;             // Since power on
+    uint32_t watchdogResets;    // Since power on
+    uint8_t resetCause;         // resetCause_t of this boot
+    uint8_t lastMiss;           // supervisorTask_t that last missed a deadline, of any boot
+    uint8_t lastMissBeforeReset;    // lastMiss as it was at this boot
+    uint8_t reserved;
+    uint32_t misses[SUPERVISOR_TASKS];  // Since power on
+} supervisorRecord_t;
+
+//=====[Declaration and initialization of private constants]===================
+
+static const char* const taskNames[SUPERVISOR_TASKS] = {
+    "alarm",
+    "report",
+    "command",
+};
+
+static const char* const resetCauseNames[RESET_CAUSES] = {
+    "power on",
+    "reset pin",
+    "software",
+    "watchdog",
+    "low power",
+};
+
+//=====[Declaration and initialization of private global variables]============
+
+static volatile supervisorRecord_t* const record = (volatile supervisorRecord_t*)BKPSRAM_BASE;
+
+static volatile bool checkInPending[SUPERVISOR_TASKS];
+static bool missedThisPeriod = false;
+static unsigned int kicksWithheld = 0;
+
+//=====[Declarations (prototypes) of private functions]========================
+
+static resetCause_t resetCauseRead();
+static void taskMiss(supervisorTask_t task);
+
+//=====[Implementations of public functions]===================================
+
+// Records why the board started then starts the watchdog. The first kick is
+// due within SUPERVISOR_WATCHDOG_MS, so the rest of the start-up must fit in it.
+void supervisorInit()
+{
+    resetCause_t cause = resetCauseRead();
+
+    RCC->APB1ENR |= RCC_APB1ENR_PWREN;
+    PWR->CR |= PWR_CR_DBP;                  // Backup domain writes
+    RCC->AHB1ENR |= RCC_AHB1ENR_BKPSRAMEN;
+
+    if (cause == RESET_POWER_ON || record->magic != SUPERVISOR_MAGIC) {
+        record->magic = SUPERVISOR_MAGIC;
+        record->boots = 0;
+        record->watchdogResets = 0;
+        record->lastMiss = SUPERVISOR_NO_TASK;
+        for (int task = 0; task < SUPERVISOR_TASKS; task++) {
+            record->misses[task] = 0;
+        }
+    }
+    record->boots = record->boots + 1;
+    record->resetCause = (uint8_t)cause;
+    record->lastMissBeforeReset = record->lastMiss;
+    if (cause == RESET_WATCHDOG) {
+        record->watchdogResets = record->watchdogResets + 1;
+    }
+
+    Watchdog::get_instance().start(SUPERVISOR_WATCHDOG_MS);
+}
+
+// For a task that is timed rather than asked to check in
+void supervisorDeadline(supervisorTask_t task, bool met)
+{
+    if (!met) {
+        taskMiss(task);
+    }
+}
+
+// Starts a check-in round for a task on another thread. Returns true if the
+// caller should now post supervisorCheckIn(task) to it, false if the last one
+// has still not run, which is a miss.
+bool supervisorCheckInStart(supervisorTask_t task)
+{
+    if (checkInPending[task]) {
+        taskMiss(task);
+        return false;
+    }
+    checkInPending[task] = true;
+    return true;
+}
+
+// Runs on the task's own thread
+void supervisorCheckIn(supervisorTask_t task)
+{
+    checkInPending[task] = false;
+}
+
+// Runs once per period after the deadlines were checked. A stall that
+// outlasts SUPERVISOR_WATCHDOG_MS then resets the board, a single overrun only
+// shows in the counters.
+void supervisorKick()
+{
+    if (missedThisPeriod) {
+        kicksWithheld++;
+        missedThisPeriod = false;
+        return;
+    }
+    Watchdog::get_instance().kick();
+}
+
+// "[SUPERVISOR] boot <n>, reset by <cause>, <n> watchdog resets, last miss before it <task>"
+// then "[SUPERVISOR] <task> <n> misses" for every task and the kicks withheld
+void supervisorSend()
+{
+    char line[SUPERVISOR_LINE_LENGTH];
+    size_t length = 0;
+
+    length += literalAppend(&line[length], "[SUPERVISOR] boot ");
+    length += decimalWrite(&line[length], record->boots);
+    length += literalAppend(&line[length], ", reset by ");
+    length += textAppend(&line[length], resetCauseNames[record->resetCause]);
+    length += literalAppend(&line[length], ", ");
+    length += decimalWrite(&line[length], record->watchdogResets);
+    length += literalAppend(&line[length], " watchdog resets, last miss before it ");
+    length += textAppend(&line[length], record->lastMissBeforeReset < SUPERVISOR_TASKS ?
+                                        taskNames[record->lastMissBeforeReset] : "none");
+    length += literalAppend(&line[length], "\r\n");
+    serialTxWrite(line, length, TX_NEVER_DROP);
+
+    for (int task = 0; task < SUPERVISOR_TASKS; task++) {
+        length = 0;
+        length += literalAppend(&line[length], "[SUPERVISOR] ");
+        length += textAppend(&line[length], taskNames[task]);
+        line[length++] = ' ';
+        length += decimalWrite(&line[length], record->misses[task]);
+        length += literalAppend(&line[length], " misses\r\n");
+        serialTxWrite(line, length, TX_NEVER_DROP);
+    }
+
+    length = 0;
+    length += literalAppend(&line[length], "[SUPERVISOR] ");
+    length += decimalWrite(&line[length], kicksWithheld);
+    length += literalAppend(&line[length], " kicks withheld, watchdog ");
+    length += decimalWrite(&line[length], SUPERVISOR_WATCHDOG_MS);
+    length += literalAppend(&line[length], " ms\r\n");
+    serialTxWrite(line, length, TX_NEVER_DROP);
+}
+
+//=====[Implementations of private functions]==================================
+
+// The reset pin flag is set by every kind of reset, as the chip drives NRST
+// itself, so the other flags are checked first. The flags are then cleared
+// for the next boot.
+static resetCause_t resetCauseRead()
+{
+    uint32_t flags = RCC->CSR;
+    resetCause_t cause = RESET_PIN;
+
+    if (flags & (RCC_CSR_IWDGRSTF | RCC_CSR_WWDGRSTF)) {
+        cause = RESET_WATCHDOG;
+    } else if (flags & RCC_CSR_LPWRRSTF) {
+        cause = RESET_LOW_POWER;
+    } else if (flags & RCC_CSR_SFTRSTF) {
+        cause = RESET_SOFTWARE;
+    } else if (flags & (RCC_CSR_PORRSTF | RCC_CSR_BORRSTF)) {
+        cause = RESET_POWER_ON;
+    }
+    RCC->CSR |= RCC_CSR_RMVF;
+    return cause;
+}
+
+static void taskMiss(supervisorTask_t task)
+{
+    record->misses[task] = record->misses[task] + 1;
+    record->lastMiss = (uint8_t)task;
+    missedThisPeriod = true;
+}
+
+#endif
@@ -0,0 +1,45 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _SUPERVISOR_H_
+#define _SUPERVISOR_H_
+
+//=====[Libraries]=============================================================
+
+#include <stdint.h>
+
+#include "alarm_config.h"
+
+//=====[Declaration of public data types]======================================
+
+typedef enum {
+    SUPERVISOR_ALARM,           // Alarm loop: the supervisor job itself started on time
+    SUPERVISOR_REPORT,          // Report thread, or the report calls of a single thread build
+    SUPERVISOR_COMMAND,         // Command thread, threaded build only
+    SUPERVISOR_TASKS
+} supervisorTask_t;
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+#if ALARM_SUPERVISOR
+
+void supervisorInit();
+void supervisorDeadline(supervisorTask_t task, bool met);
+bool supervisorCheckInStart(supervisorTask_t task);
+void supervisorCheckIn(supervisorTask_t task);
+void supervisorKick();
+void supervisorSend();
+
+#else
+
+inline void supervisorInit() {}
+inline void supervisorDeadline(supervisorTask_t, bool) {}
+inline bool supervisorCheckInStart(supervisorTask_t) { return false; }
+inline void supervisorCheckIn(supervisorTask_t) {}
+inline void supervisorKick() {}
+inline void supervisorSend() {}
+
+#endif
+
+//=====[#include guards - end]=================================================
+
+#endif // _SUPERVISOR_H_
@@ -0,0 +1,72 @@
+//=====[Libraries]=============================================================
+
+#include <atomic>
+
+#include "mbed.h"
+#include "arm_book_lib.h"
+
+#include "system_state.h"
+#include "alarm_logic.h"
+
+//=====[Declaration of private defines]========================================
+
+// The whole state fits one word, so a single atomic load is a consistent
+// snapshot: readers never retry, never mask interrupts and never block.
+//   [0-15]   active sensors, bit i for sensors[i]
+//   [16]     alarm on
+//   [17]     lockout
+//   [18-21]  incorrect codes
+//   [22-31]  sequence number
+#define STATE_SENSORS_MASK      0x0000FFFFu
+#define STATE_ALARM_BIT         (1u << 16)
+#define STATE_LOCKOUT_BIT       (1u << 17)
+#define STATE_CODES_SHIFT       18
+#define STATE_CODES_MASK        (0xFu << STATE_CODES_SHIFT)
+#define STATE_SEQUENCE_SHIFT    22
+#define STATE_SEQUENCE_MASK     (0x3FFu << STATE_SEQUENCE_SHIFT)
+
+static_assert(INPUT_SENSOR_LIMIT <= 16, "The sensors no longer fit the state word");
+static_assert(ALARM_INCORRECT_CODES_LIMIT <= (STATE_CODES_MASK >> STATE_CODES_SHIFT),
+              "The incorrect code count no longer fits the state word");
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "The state word must be lock free");
+
+//=====[Declaration and initialization of private global variables]============
+
+static std::atomic<uint32_t> stateWord(0);
+
+//=====[Implementations of public functions]===================================
+
+// Replaces the published state and returns true if it differs from the last.
+// The sequence number is bumped with a compare and swap, so publishing from
+// more than one context, an interrupt included, still loses no update.
+bool systemStatePublish(inputMask_t sensors, bool alarmState, bool lockout, uint8_t incorrectCodes)
+{
+    uint32_t state = ((uint32_t)sensors & STATE_SENSORS_MASK) |
+                     (alarmState ? STATE_ALARM_BIT : 0) |
+                     (lockout ? STATE_LOCKOUT_BIT : 0) |
+                     (((uint32_t)incorrectCodes << STATE_CODES_SHIFT) & STATE_CODES_MASK);
+    uint32_t previous = stateWord.load(std::memory_order_relaxed);
+    uint32_t next;
+
+    do {
+        if ((previous & ~STATE_SEQUENCE_MASK) == state) {
+            return false;
+        }
+        next = state | ((previous + (1u << STATE_SEQUENCE_SHIFT)) & STATE_SEQUENCE_MASK);
+    } while (!stateWord.compare_exchange_weak(previous, next, std::memory_order_release,
+                                              std::memory_order_relaxed));
+    return true;
+}
+
+systemState_t systemStateRead()
+{
+    uint32_t word = stateWord.load(std::memory_order_acquire);
+    systemState_t state;
+
+    state.sensors = word & STATE_SENSORS_MASK;
+    state.alarmState = (word & STATE_ALARM_BIT) != 0;
+    state.lockout = (word & STATE_LOCKOUT_BIT) != 0;
+    state.incorrectCodes = (uint8_t)((word & STATE_CODES_MASK) >> STATE_CODES_SHIFT);
+    state.sequence = (uint16_t)((word & STATE_SEQUENCE_MASK) >> STATE_SEQUENCE_SHIFT);
+    return state;
+}
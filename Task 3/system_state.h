@@ -0,0 +1,30 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _SYSTEM_STATE_H_
+#define _SYSTEM_STATE_H_
+
+//=====[Libraries]=============================================================
+
+#include <stdint.h>
+
+#include "inputs.h"
+
+//=====[Declaration of public data types]======================================
+
+// The alarm state as the commands and reports see it, unpacked from one word
+typedef struct {
+    inputMask_t sensors;        // Active sensors, gas and temperature follow from the sensor masks
+    bool alarmState;
+    bool lockout;
+    uint8_t incorrectCodes;
+    uint16_t sequence;          // Changes with every published update, wraps at 1024
+} systemState_t;
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+bool systemStatePublish(inputMask_t sensors, bool alarmState, bool lockout, uint8_t incorrectCodes);
+systemState_t systemStateRead();
+
+//=====[#include guards - end]=================================================
+
+#endif // _SYSTEM_STATE_H_
@@ -0,0 +1,182 @@
+//=====[Libraries]=============================================================
+
+#include "mbed.h"
+#include "arm_book_lib.h"
+
+#include "telemetry.h"
+#include "crc.h"
+#include "serial_tx.h"
+
+//=====[Declaration of private defines]========================================
+
+// Binary packet, little endian, before COBS encoding:
+//   [0]    packet type (TELEMETRY_PACKET_*)
+//   [1-2]  sequence number, incremented per packet
+//   [3-6]  timestamp in ms since power on
+//   [7..]  payload
+//   last 2 CRC-16/CCITT-FALSE of all the bytes before it
+// On the wire the COBS encoded packet sits between two 0x00 delimiters, so
+// anything before a frame, line noise or a half sent frame, only costs the
+// decoder one bad frame and never the next good one.
+//
+// Payloads:
+//   TELEMETRY_PACKET_STATUS  [7] STATUS_*_BIT flags
+//   TELEMETRY_PACKET_STATE   [7] STATUS_*_BIT flags, [8] number of incorrect codes,
+//                            [9-10] active sensors, bit i for sensors[i]
+//   TELEMETRY_PACKET_ANALOG  per analog sensor: [n] index in sensors[], [n+1 - n+2] level in mV
+//   TELEMETRY_PACKET_SAMPLES raw ADC samples, see stream.cpp
+//   TELEMETRY_PACKET_WARNING [7] index in sensors[], [8-9] onsets suppressed since
+//                            the last warning, at most 65535
+//   TELEMETRY_PACKET_TEXT    a piece of a text reply, no terminator; the pieces of
+//                            one reply are sent back to back
+#define TELEMETRY_PACKET_STATUS     0x01
+#define TELEMETRY_PACKET_STATE      0x02
+#define TELEMETRY_PACKET_ANALOG     0x03
+#define TELEMETRY_PACKET_WARNING    0x05
+#define TELEMETRY_PACKET_TEXT       0x06
+#define TELEMETRY_MAX_PAYLOAD       (3 * TELEMETRY_MAX_ANALOG)
+
+//=====[Declaration and initialization of private global variables]============
+
+static telemetryMode_t telemetryMode = TELEMETRY_TEXT;
+static uint16_t telemetrySequence = 0;     // Shared with the samples packets from the stream module
+
+//=====[Declarations (prototypes) of private functions]========================
+
+static void telemetryPacketSend(uint8_t type, const uint8_t* payload, size_t payloadLength,
+                                serialTxPolicy_t policy);
+static void telemetryTextSend(const char* text, size_t length, serialTxPolicy_t policy);
+static size_t cobsEncode(const uint8_t* data, size_t length, uint8_t* encoded);
+
+//=====[Implementations of public functions]===================================
+
+// In binary mode every text reply is wrapped in TELEMETRY_PACKET_TEXT packets,
+// so nothing unframed reaches the gateway's decoder
+void telemetryModeWrite(telemetryMode_t mode)
+{
+    telemetryMode = mode;
+    serialTxTextHookSet(mode == TELEMETRY_BINARY ? telemetryTextSend : nullptr);
+}
+
+telemetryMode_t telemetryModeRead()
+{
+    return telemetryMode;
+}
+
+void telemetryStatusSend(uint8_t statusBits)
+{
+    telemetryPacketSend(TELEMETRY_PACKET_STATUS, &statusBits, 1, TX_NEVER_DROP);
+}
+
+// Answer to the query-all command: everything a poller needs in one packet
+void telemetryStateSend(uint8_t statusBits, uint8_t incorrectCodes, uint16_t sensorBits)
+{
+    uint8_t payload[4] = { statusBits, incorrectCodes, (uint8_t)sensorBits, (uint8_t)(sensorBits >> 8) };
+
+    telemetryPacketSend(TELEMETRY_PACKET_STATE, payload, sizeof(payload), TX_NEVER_DROP);
+}
+
+// Sent after the status packet when there are analog sensors
+void telemetryAnalogSend(const telemetryAnalog_t* levels, int count)
+{
+    uint8_t payload[TELEMETRY_MAX_PAYLOAD];
+    size_t length = 0;
+
+    for (int i = 0; i < count && i < TELEMETRY_MAX_ANALOG; i++) {
+        payload[length++] = levels[i].sensor;
+        payload[length++] = (uint8_t)levels[i].millivolts;
+        payload[length++] = (uint8_t)(levels[i].millivolts >> 8);
+    }
+    telemetryPacketSend(TELEMETRY_PACKET_ANALOG, payload, length, TX_NEVER_DROP);
+}
+
+// The binary form of a sensor warning, queued with the sensor's own policy
+void telemetryWarningSend(uint8_t sensor, unsigned int suppressed, serialTxPolicy_t policy)
+{
+    uint16_t count = (suppressed > 0xFFFF) ? 0xFFFF : (uint16_t)suppressed;
+    uint8_t payload[3] = { sensor, (uint8_t)count, (uint8_t)(count >> 8) };
+
+    telemetryPacketSend(TELEMETRY_PACKET_WARNING, payload, sizeof(payload), policy);
+}
+
+// Fills in the header and CRC around the payload already written at
+// packet[TELEMETRY_HEADER_LENGTH] and COBS encodes the packet into frame,
+// both delimiters included. Returns the frame length. Also safe in interrupt context.
+size_t telemetryFrameBuild(uint8_t type, uint8_t* packet, size_t payloadLength, uint8_t* frame)
+{
+    uint32_t timestamp = (uint32_t)Kernel::Clock::now().time_since_epoch().count();
+    size_t length = TELEMETRY_HEADER_LENGTH + payloadLength;
+
+    core_util_critical_section_enter();
+    uint16_t sequence = telemetrySequence++;
+    core_util_critical_section_exit();
+
+    packet[0] = type;
+    packet[1] = (uint8_t)sequence;
+    packet[2] = (uint8_t)(sequence >> 8);
+    packet[3] = (uint8_t)timestamp;
+    packet[4] = (uint8_t)(timestamp >> 8);
+    packet[5] = (uint8_t)(timestamp >> 16);
+    packet[6] = (uint8_t)(timestamp >> 24);
+
+    uint16_t crc = crc16Ccitt(packet, length);
+    packet[length++] = (uint8_t)crc;
+    packet[length++] = (uint8_t)(crc >> 8);
+
+    frame[0] = 0x00;
+    size_t frameLength = 1 + cobsEncode(packet, length, &frame[1]);
+    frame[frameLength++] = 0x00;
+    return frameLength;
+}
+
+//=====[Implementations of private functions]==================================
+
+static void telemetryPacketSend(uint8_t type, const uint8_t* payload, size_t payloadLength,
+                                serialTxPolicy_t policy)
+{
+    uint8_t packet[TELEMETRY_PACKET_LENGTH(TELEMETRY_MAX_PAYLOAD)];
+    uint8_t frame[TELEMETRY_FRAME_LENGTH(TELEMETRY_MAX_PAYLOAD)];
+
+    memcpy(&packet[TELEMETRY_HEADER_LENGTH], payload, payloadLength);
+    size_t frameLength = telemetryFrameBuild(type, packet, payloadLength, frame);
+    serialTxBinaryWrite((const char*)frame, frameLength, policy);
+}
+
+// The text hook in binary mode, see telemetryModeWrite()
+static void telemetryTextSend(const char* text, size_t length, serialTxPolicy_t policy)
+{
+    while (length > 0) {
+        size_t pieceLength = (length > TELEMETRY_MAX_PAYLOAD) ? TELEMETRY_MAX_PAYLOAD : length;
+
+        telemetryPacketSend(TELEMETRY_PACKET_TEXT, (const uint8_t*)text, pieceLength, policy);
+        text += pieceLength;
+        length -= pieceLength;
+    }
+}
+
+// Consistent overhead byte stuffing: removes every 0x00 so it can delimit frames.
+// Returns the encoded length, which is at most length + length / 254 + 1.
+static size_t cobsEncode(const uint8_t* data, size_t length, uint8_t* encoded)
+{
+    size_t codeIndex = 0;
+    size_t writeIndex = 1;
+    uint8_t code = 1;
+
+    for (size_t i = 0; i < length; i++) {
+        if (data[i] == 0x00) {
+            encoded[codeIndex] = code;
+            codeIndex = writeIndex++;
+            code = 1;
+        } else {
+            encoded[writeIndex++] = data[i];
+            code++;
+            if (code == 0xFF) {
+                encoded[codeIndex] = code;
+                codeIndex = writeIndex++;
+                code = 1;
+            }
+        }
+    }
+    encoded[codeIndex] = code;
+    return writeIndex;
+}
@@ -0,0 +1,54 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+//=====[Libraries]=============================================================
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "serial_tx.h"
+
+//=====[Declaration of public defines]=========================================
+
+// System status bits, shared by the text report frame index and the binary packet
+#define STATUS_ALARM_BIT        0x4
+#define STATUS_GAS_BIT          0x2
+#define STATUS_TEMP_BIT         0x1
+#define STATUS_LOCKOUT_BIT      0x8     // Only in the query-all answer
+
+#define TELEMETRY_MAX_ANALOG    16      // Analog levels carried by one packet
+
+#define TELEMETRY_PACKET_SAMPLES    0x04    // Built by the stream module
+
+// Buffer sizes for telemetryFrameBuild with n payload bytes
+#define TELEMETRY_HEADER_LENGTH     7
+#define TELEMETRY_PACKET_LENGTH(n)  (TELEMETRY_HEADER_LENGTH + (n) + 2)
+#define TELEMETRY_FRAME_LENGTH(n)   (TELEMETRY_PACKET_LENGTH(n) + TELEMETRY_PACKET_LENGTH(n) / 254 + 3)
+
+//=====[Declaration of public data types]======================================
+
+typedef enum {
+    TELEMETRY_TEXT,     // Human readable [STATUS REPORT] frames
+    TELEMETRY_BINARY,   // COBS framed packets, see telemetry.cpp for the layout
+} telemetryMode_t;
+
+typedef struct {
+    uint8_t sensor;             // Index in sensors[]
+    uint16_t millivolts;
+} telemetryAnalog_t;
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+void telemetryModeWrite(telemetryMode_t mode);
+telemetryMode_t telemetryModeRead();
+void telemetryStatusSend(uint8_t statusBits);
+void telemetryStateSend(uint8_t statusBits, uint8_t incorrectCodes, uint16_t sensorBits);
+void telemetryAnalogSend(const telemetryAnalog_t* levels, int count);
+void telemetryWarningSend(uint8_t sensor, unsigned int suppressed, serialTxPolicy_t policy);
+size_t telemetryFrameBuild(uint8_t type, uint8_t* packet, size_t payloadLength, uint8_t* frame);
+
+//=====[#include guards - end]=================================================
+
+#endif // _TELEMETRY_H_
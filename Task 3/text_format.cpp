@@ -0,0 +1,63 @@
+//=====[Libraries]=============================================================
+
+#include <limits.h>
+
+#include "text_format.h"
+
+//=====[Implementations of public functions]===================================
+
+// Writes value in decimal without a terminator and returns the number of digits
+size_t decimalWrite(char* buffer, unsigned int value)
+{
+    char digits[10];
+    size_t count = 0;
+
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+
+    for (size_t i = 0; i < count; i++) {
+        buffer[i] = digits[count - 1 - i];
+    }
+    return count;
+}
+
+// Writes a value given in tenths with one decimal place, e.g. 123 as "12.3"
+size_t decimalTenthsWrite(char* buffer, unsigned int tenths)
+{
+    size_t length = decimalWrite(buffer, tenths / 10);
+
+    buffer[length++] = '.';
+    buffer[length++] = '0' + tenths % 10;
+    return length;
+}
+
+// Reads an unsigned decimal number made only of digits. Returns false, leaving
+// value unchanged, for an empty string, any other character or an overflow.
+bool decimalParse(const char* text, unsigned int* value)
+{
+    unsigned int result = 0;
+
+    if (*text == '\0') {
+        return false;
+    }
+    for (; *text != '\0'; text++) {
+        if (*text < '0' || *text > '9' || result > (UINT_MAX - (*text - '0')) / 10) {
+            return false;
+        }
+        result = result * 10 + (*text - '0');
+    }
+    *value = result;
+    return true;
+}
+
+// Copies a string that is not a literal, such as a name from a table, without
+// its terminator and returns its length
+size_t textAppend(char* buffer, const char* text)
+{
+    size_t length = strlen(text);
+
+    memcpy(buffer, text, length);
+    return length;
+}
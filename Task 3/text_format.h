@@ -0,0 +1,37 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _TEXT_FORMAT_H_
+#define _TEXT_FORMAT_H_
+
+//=====[Libraries]=============================================================
+
+#include <stddef.h>
+#include <string.h>
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+size_t decimalWrite(char* buffer, unsigned int value);
+size_t decimalTenthsWrite(char* buffer, unsigned int tenths);
+bool decimalParse(const char* text, unsigned int* value);
+size_t textAppend(char* buffer, const char* text);
+
+//=====[Implementations of public template functions]==========================
+
+// Length of a string literal without its terminator, worked out by the compiler
+template <size_t N>
+constexpr size_t literalLength(const char (&)[N])
+{
+    return N - 1;
+}
+
+// Copies a string literal without its terminator and returns its length
+template <size_t N>
+inline size_t literalAppend(char* buffer, const char (&text)[N])
+{
+    memcpy(buffer, text, N - 1);
+    return N - 1;
+}
+
+//=====[#include guards - end]=================================================
+
+#endif // _TEXT_FORMAT_H_
@@ -0,0 +1,80 @@
+//=====[Libraries]=============================================================
+
+#include "mbed.h"
+#include "arm_book_lib.h"
+
+#include "alarm_config.h"
+#include "threads.h"
+
+#if ALARM_THREADED
+
+#include "serial_tx.h"
+#include "text_format.h"
+
+//=====[Declaration of private defines]========================================
+
+// The alarm thread preempts the other two as soon as an edge or a code entry
+// poll is queued, so a command dump or a report never delays the alarm LED.
+// The main thread becomes the report thread, with its stack set by
+// rtos.main-thread-stack-size. Stack sizes are trimmed from the high-water
+// marks sent by threadsStackSend().
+#define ALARM_THREAD_PRIORITY   osPriorityHigh
+#define COMMAND_THREAD_PRIORITY osPriorityNormal
+#define REPORT_THREAD_PRIORITY  osPriorityBelowNormal
+#define ALARM_THREAD_STACK      1536
+#define COMMAND_THREAD_STACK    2048
+
+#define THREADS_MAX_REPORTED    8       // main, idle, timer and the threads here
+#define THREAD_NAME_MAX_LENGTH  16
+#define THREAD_LINE_LENGTH      64
+
+//=====[Declaration and initialization of private global objects]==============
+
+static Thread alarmThread(ALARM_THREAD_PRIORITY, ALARM_THREAD_STACK, nullptr, "alarm");
+static Thread commandThread(COMMAND_THREAD_PRIORITY, COMMAND_THREAD_STACK, nullptr, "command");
+
+//=====[Implementations of public functions]===================================
+
+// Starts a thread dispatching each queue, then drops the calling main thread
+// to the report priority, so it can go on to dispatch the report queue
+void threadsStart(EventQueue* alarmQueue, EventQueue* commandQueue)
+{
+    alarmThread.start(callback(alarmQueue, &EventQueue::dispatch_forever));
+    commandThread.start(callback(commandQueue, &EventQueue::dispatch_forever));
+    osThreadSetPriority(ThisThread::get_id(), REPORT_THREAD_PRIORITY);
+}
+
+// One "[THREAD] <name> <used> of <size> bytes" line per thread, used being the
+// stack high-water mark. RTX fills each stack with a pattern when it is created
+// as platform.stack-stats-enabled is set, the deepest overwritten word is the mark.
+void threadsStackSend()
+{
+    mbed_stats_stack_t stacks[THREADS_MAX_REPORTED];
+    size_t count = mbed_stats_stack_get_each(stacks, THREADS_MAX_REPORTED);
+
+    if (count == 0) {
+        serialTxWriteLiteral("[THREAD] Stack statistics not enabled\r\n", TX_NEVER_DROP);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        char line[THREAD_LINE_LENGTH];
+        size_t length = 0;
+        const char* name = osThreadGetName((osThreadId_t)stacks[i].thread_id);
+
+        if (name == nullptr) {
+            name = "unnamed";
+        }
+        length += literalAppend(&line[length], "[THREAD] ");
+        for (size_t c = 0; name[c] != '\0' && c < THREAD_NAME_MAX_LENGTH; c++) {
+            line[length++] = name[c];
+        }
+        line[length++] = ' ';
+        length += decimalWrite(&line[length], stacks[i].max_size);
+        length += literalAppend(&line[length], " of ");
+        length += decimalWrite(&line[length], stacks[i].reserved_size);
+        length += literalAppend(&line[length], " bytes\r\n");
+        serialTxWrite(line, length, TX_NEVER_DROP);
+    }
+}
+
+#endif
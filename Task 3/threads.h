@@ -0,0 +1,17 @@
+//=====[#include guards - begin]===============================================
+
+#ifndef _THREADS_H_
+#define _THREADS_H_
+
+//=====[Libraries]=============================================================
+
+#include "mbed.h"
+
+//=====[Declarations (prototypes) of public functions]=========================
+
+void threadsStart(EventQueue* alarmQueue, EventQueue* commandQueue);
+void threadsStackSend();
+
+//=====[#include guards - end]=================================================
+
+#endif // _THREADS_H_
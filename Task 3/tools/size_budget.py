@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+"""Flash and RAM budget check for the alarm image.
+
+Prints the flash and static RAM used by an ELF image, the largest symbols in
+each, and exits with status 1 when either total is over the budget set in the
+app config the image was built with:
+
+    mbed compile -m NUCLEO_F439ZI -t GCC_ARM --profile profiles/size.json \\
+        --app-config mbed_app_size.json
+    python3 tools/size_budget.py BUILD/NUCLEO_F439ZI/GCC_ARM-SIZE/Task_3.elf \\
+        --app-config mbed_app_size.json
+
+Flash is every allocated read only section plus the .data initialisers, RAM is
+.data and .bss. The heap and the stack sections fill whatever RAM is left, so
+they are not counted. Symbols come from arm-none-eabi-nm, the sections are
+read from the ELF header directly.
+
+mbed-cli takes a whole app config and JSON has no includes, so
+mbed_app_size.json and mbed_app_bare_metal.json repeat the parameters of
+mbed_app.json. mbed_app.json is where they are defined: every parameter
+other than the budgets must match it, and the FLASHIAP component it adds must
+be there too, otherwise the check fails before the image is measured.
+"""
+
+import argparse
+import json
+import os
+import struct
+import subprocess
+import sys
+
+SHT_NOBITS = 8
+SHF_WRITE = 0x1
+SHF_ALLOC = 0x2
+
+UNCOUNTED_SECTIONS = (".heap", ".stack")    # Name prefixes, sized to fill the RAM left over
+BUDGET_PARAMETERS = ("flash-budget", "ram-budget")  # The only parameters a variant sets on its own
+SHARED_OVERRIDES = ("target.components_add",)       # Target overrides every variant needs unchanged
+
+
+def sections_read(path):
+    """Return (name, address, size, flash, ram) for every allocated section."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:4] != b"\x7fELF" or data[4] != 1 or data[5] != 1:
+        raise ValueError(path + " is not a 32-bit little endian ELF file")
+
+    shoff, = struct.unpack_from("<I", data, 0x20)
+    shentsize, shnum, shstrndx = struct.unpack_from("<HHH", data, 0x2E)
+    headers = [struct.unpack_from("<IIIIIIIIII", data, shoff + i * shentsize) for i in range(shnum)]
+    names = headers[shstrndx][4]
+
+    sections = []
+    for name, kind, flags, address, _, size, _, _, _, _ in headers:
+        if not flags & SHF_ALLOC or size == 0:
+            continue
+        name = data[names + name:data.index(b"\0", names + name)].decode()
+        if name.startswith(UNCOUNTED_SECTIONS):
+            continue
+        writable = bool(flags & SHF_WRITE)
+        flash = not writable or kind != SHT_NOBITS      # Code, constants and .data initialisers
+        sections.append((name, address, size, flash, writable))
+    return sections
+
+
+def symbols_read(path, nm):
+    """Return (address, size, name) for every sized symbol, largest first."""
+    output = subprocess.run([nm, "--print-size", "--size-sort", "--reverse-sort", "--demangle", path],
+                            check=True, stdout=subprocess.PIPE, universal_newlines=True).stdout
+    symbols = []
+    for line in output.splitlines():
+        fields = line.split(None, 3)
+        if len(fields) == 4:
+            symbols.append((int(fields[0], 16), int(fields[1], 16), fields[3]))
+    return symbols
+
+
+def budgets_read(path):
+    """Return (flash, ram) budgets from the "config" section of an app config."""
+    with open(path) as f:
+        config = json.load(f).get("config", {})
+    return config["flash-budget"]["value"], config["ram-budget"]["value"]
+
+
+def config_drift(path, reference):
+    """Return what the app config at path does not share with the reference one."""
+    with open(path) as f:
+        config = json.load(f)
+    with open(reference) as f:
+        shared = json.load(f)
+
+    problems = []
+    parameters = config.get("config", {})
+    for name, parameter in shared.get("config", {}).items():
+        if name not in BUDGET_PARAMETERS and parameters.get(name) != parameter:
+            problems.append('parameter "%s" differs from %s' % (name, os.path.basename(reference)))
+    for name in parameters:
+        if name not in shared.get("config", {}):
+            problems.append('parameter "%s" is missing from %s' % (name, os.path.basename(reference)))
+    overrides = config.get("target_overrides", {}).get("*", {})
+    for name in SHARED_OVERRIDES:
+        value = shared.get("target_overrides", {}).get("*", {}).get(name)
+        if value is not None and overrides.get(name) != value:
+            problems.append('target override "%s" differs from %s' % (name, os.path.basename(reference)))
+    return problems
+
+
+def region_report(title, used, budget, symbols, top):
+    print("%-6s %8d of %8d bytes (%5.1f%%)%s" %
+          (title, used, budget, 100.0 * used / budget, "  OVER BUDGET" if used > budget else ""))
+    for address, size, name, section in symbols[:top]:
+        print("    %8d  0x%08x  %-12s %s" % (size, address, section, name))
+    print()
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", help="linked image, e.g. BUILD/NUCLEO_F439ZI/GCC_ARM/Task_3.elf")
+    parser.add_argument("--app-config", default=os.path.join(here, "..", "mbed_app.json"),
+                        help="app config the image was built with, for the budgets (default mbed_app.json)")
+    parser.add_argument("--flash-budget", type=int, help="override the flash budget, in bytes")
+    parser.add_argument("--ram-budget", type=int, help="override the RAM budget, in bytes")
+    parser.add_argument("--top", type=int, default=25, help="number of symbols listed per region")
+    parser.add_argument("--nm", default="arm-none-eabi-nm", help="nm of the toolchain")
+    args = parser.parse_args()
+
+    reference = os.path.join(here, "..", "mbed_app.json")
+    problems = config_drift(args.app_config, reference)
+    for problem in problems:
+        print("%s: %s" % (args.app_config, problem), file=sys.stderr)
+    if problems:
+        return 1
+
+    flash_budget, ram_budget = budgets_read(args.app_config)
+    flash_budget = args.flash_budget or flash_budget
+    ram_budget = args.ram_budget or ram_budget
+
+    sections = sections_read(args.elf)
+    flash_used = sum(size for _, _, size, flash, _ in sections if flash)
+    ram_used = sum(size for _, _, size, _, ram in sections if ram)
+
+    flash_symbols = []
+    ram_symbols = []
+    for address, size, name in symbols_read(args.elf, args.nm):
+        for section, start, length, flash, ram in sections:
+            if start <= address < start + length:
+                if flash:
+                    flash_symbols.append((address, size, name, section))
+                if ram:
+                    ram_symbols.append((address, size, name, section))
+                break
+
+    for section, start, length, flash, ram in sections:
+        print("%-20s 0x%08x %8d  %s" % (section, start, length,
+                                        "flash + RAM" if flash and ram else "flash" if flash else "RAM"))
+    print()
+    region_report("Flash", flash_used, flash_budget, flash_symbols, args.top)
+    region_report("RAM", ram_used, ram_budget, ram_symbols, args.top)
+
+    return 1 if flash_used > flash_budget or ram_used > ram_budget else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())